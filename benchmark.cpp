@@ -0,0 +1,353 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include "memhier.h"
+#include "tracefile.h"
+#include "tracegen.h"
+#include "report.h"
+
+using namespace std;
+
+// Throughput benchmark for the simulator itself. Every pattern of tracegen.h is generated
+// in memory and timed through each stage of a run:
+//
+//  - parse-text, parse-binary: decoding the trace from a text and a delta binary file
+//  - translate:  TLB and page table only
+//  - dc-only:    translation and the data cache, without an L2
+//  - full:       the whole hierarchy
+//  - report:     the whole hierarchy plus formatting every report row
+//
+// The simulation stages run on each cache shape below. Each measurement is the best of
+// a number of repeats, printed as one CSV row, so results of two versions can be
+// compared with --baseline.
+
+struct BenchmarkShape
+{
+    const char *name;
+    int dcSets;
+    int dcWays;
+    int l2Sets;
+    int l2Ways;
+};
+
+const BenchmarkShape BENCHMARK_SHAPES[] = {
+    {"small", 64, 2, 256, 8},    // 8 KiB DC, 128 KiB L2
+    {"medium", 64, 8, 1024, 8},  // 32 KiB DC, 512 KiB L2
+    {"large", 256, 8, 2048, 16}, // 128 KiB DC, 2 MiB L2
+};
+const int BENCHMARK_LINE_SIZE = 64;
+
+enum BenchmarkStage
+{
+    STAGE_TRANSLATE,
+    STAGE_DC_ONLY,
+    STAGE_FULL,
+    STAGE_REPORT
+};
+
+const char *const BENCHMARK_STAGE_NAMES[] = {"translate", "dc-only", "full", "report"};
+
+struct BenchmarkResult
+{
+    string stage;
+    string pattern;
+    string shape;
+    uint64_t accesses;
+    double seconds;
+};
+
+typedef tuple<string, string, string> BenchmarkKey;
+
+Configuration benchmarkConfig(const BenchmarkShape &shape, bool useL2Cache)
+{
+    Configuration config;
+    config.dtlbConfig.numSets = 16;
+    config.dtlbConfig.setSize = 4;
+    config.dtlbConfig.policy = POLICY_LRU;
+    config.ptConfig.numVirtualPages = 256;
+    config.ptConfig.numPhysicalPages = 1024;
+    config.ptConfig.pageSize = 4096;
+    config.ptConfig.policy = POLICY_LRU;
+    config.dcConfig.numSets = shape.dcSets;
+    config.dcConfig.setSize = shape.dcWays;
+    config.dcConfig.lineSize = BENCHMARK_LINE_SIZE;
+    config.dcConfig.writeThroughOrNoWriteAllocate = false;
+    config.dcConfig.policy = POLICY_LRU;
+    config.l2Config.numSets = shape.l2Sets;
+    config.l2Config.setSize = shape.l2Ways;
+    config.l2Config.lineSize = BENCHMARK_LINE_SIZE;
+    config.l2Config.policy = POLICY_LRU;
+    config.useVirtualAddresses = true;
+    config.useTLB = true;
+    config.useL2Cache = useL2Cache;
+    return config;
+}
+
+double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Seconds to read every record of traceFile, or a negative value if it could not be read.
+double timeParse(const string &traceFile, uint64_t expected)
+{
+    auto start = chrono::steady_clock::now();
+    TraceReader reader;
+    if (!openTraceFile(reader, traceFile))
+    {
+        return -1;
+    }
+    TraceRecord record;
+    uint64_t records = 0;
+    while (nextTraceRecord(reader, record))
+    {
+        records++;
+    }
+    closeTraceFile(reader);
+    double seconds = secondsSince(start);
+    return records == expected ? seconds : -1;
+}
+
+// Seconds to run a fresh simulator over trace; setting it up is not timed.
+double timeSimulation(BenchmarkStage stage, const BenchmarkShape &shape, const vector<TraceRecord> &trace)
+{
+    Simulator simulator(benchmarkConfig(shape, stage != STAGE_DC_ONLY));
+    ReportWriter report;
+    openReport(report); // no destinations, so every flush drops the rows
+    TraceData row;
+    volatile uint64_t sink = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (const TraceRecord &record : trace)
+    {
+        if (stage == STAGE_TRANSLATE)
+        {
+            row = TraceData();
+            sink = simulator.translateAccess(record.address, record.core, row);
+        }
+        else
+        {
+            simulator.simulateMemoryAccess(record.address, record.accessType, record.core);
+            if (stage == STAGE_REPORT)
+                printTraceData(report, simulator.traceData);
+        }
+    }
+    reportFlush(report);
+    double seconds = secondsSince(start);
+    (void)sink;
+    return seconds;
+}
+
+bool readBaseline(const string &filename, map<BenchmarkKey, double> &baseline)
+{
+    ifstream file(filename);
+    if (!file.is_open())
+    {
+        cerr << "Error: Unable to open baseline file " << filename << "." << endl;
+        return false;
+    }
+    string line;
+    getline(file, line); // header
+    while (getline(file, line))
+    {
+        vector<string> fields;
+        stringstream row(line);
+        string field;
+        while (getline(row, field, ','))
+        {
+            fields.push_back(field);
+        }
+        if (fields.size() == 7)
+        {
+            baseline[BenchmarkKey(fields[1], fields[2], fields[3])] = atof(fields[6].c_str());
+        }
+    }
+    return true;
+}
+
+void printUsage(const char *program)
+{
+    cerr << "Usage: " << program << " [options]" << endl;
+    cerr << "  -n N             accesses per pattern (default 1000000)" << endl;
+    cerr << "  -r N             repeats of each measurement, the best is kept (default 3)" << endl;
+    cerr << "  -f N             footprint of the patterns in bytes (default 16777216)" << endl;
+    cerr << "  --patterns P,... patterns to run (default: all)" << endl;
+    cerr << "  --scratch DIR    directory for the trace files of the parse stages (default .)" << endl;
+    cerr << "  --label NAME     first column of every row, e.g. a version (default current)" << endl;
+    cerr << "  --baseline FILE  compare with an earlier run and exit with 2 on a regression" << endl;
+    cerr << "  --tolerance F    slowdown allowed against the baseline (default 0.1)" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t accesses = 1000000;
+    int repeats = 3;
+    TraceGenOptions options;
+    vector<TracePattern> patterns;
+    string scratch = ".";
+    string label = "current";
+    string baselineFile;
+    double tolerance = 0.1;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-n") == 0 && hasValue)
+        {
+            accesses = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-r") == 0 && hasValue)
+        {
+            repeats = max(atoi(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "-f") == 0 && hasValue)
+        {
+            options.footprint = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--patterns") == 0 && hasValue)
+        {
+            stringstream list(argv[++i]);
+            string name;
+            while (getline(list, name, ','))
+            {
+                TracePattern pattern;
+                if (!parseTracePattern(name, pattern))
+                {
+                    cerr << "Error: Unknown pattern " << name << "." << endl;
+                    return 1;
+                }
+                patterns.push_back(pattern);
+            }
+        }
+        else if (strcmp(argv[i], "--scratch") == 0 && hasValue)
+        {
+            scratch = argv[++i];
+        }
+        else if (strcmp(argv[i], "--label") == 0 && hasValue)
+        {
+            label = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+        {
+            baselineFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && hasValue)
+        {
+            tolerance = atof(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (patterns.empty())
+    {
+        for (int pattern = 0; pattern < TRACE_PATTERN_COUNT; pattern++)
+            patterns.push_back(static_cast<TracePattern>(pattern));
+    }
+    map<BenchmarkKey, double> baseline;
+    if (!baselineFile.empty() && !readBaseline(baselineFile, baseline))
+    {
+        return 1;
+    }
+
+    vector<BenchmarkResult> results;
+    string textFile = scratch + "/benchmark_trace.txt";
+    string binaryFile = scratch + "/benchmark_trace.bin";
+    for (TracePattern pattern : patterns)
+    {
+        options.pattern = pattern;
+        TraceGenerator generator;
+        if (!initTraceGenerator(generator, options))
+        {
+            return 1;
+        }
+        vector<TraceRecord> trace(accesses);
+        for (TraceRecord &record : trace)
+        {
+            record = nextGeneratedRecord(generator);
+        }
+
+        const struct
+        {
+            const char *stage;
+            const string *file;
+            bool binary;
+        } parseStages[] = {
+            {"parse-text", &textFile, false},
+            {"parse-binary", &binaryFile, true},
+        };
+        for (const auto &parse : parseStages)
+        {
+            TraceWriter writer;
+            bool opened = parse.binary ? openTraceWriter(writer, *parse.file, TRACE_FLAG_DELTA) : openTextTraceWriter(writer, *parse.file, 0);
+            if (!opened)
+            {
+                return 1;
+            }
+            for (const TraceRecord &record : trace)
+            {
+                writeTraceRecord(writer, record);
+            }
+            closeTraceWriter(writer);
+
+            double best = -1;
+            for (int repeat = 0; repeat < repeats; repeat++)
+            {
+                double seconds = timeParse(*parse.file, accesses);
+                if (seconds < 0)
+                {
+                    cerr << "Error: Unable to read back " << *parse.file << "." << endl;
+                    remove(parse.file->c_str());
+                    return 1;
+                }
+                best = best < 0 ? seconds : min(best, seconds);
+            }
+            remove(parse.file->c_str());
+            results.push_back({parse.stage, tracePatternName(pattern), "-", accesses, best});
+        }
+
+        for (const BenchmarkShape &shape : BENCHMARK_SHAPES)
+        {
+            for (int stage = STAGE_TRANSLATE; stage <= STAGE_REPORT; stage++)
+            {
+                double best = -1;
+                for (int repeat = 0; repeat < repeats; repeat++)
+                {
+                    double seconds = timeSimulation(static_cast<BenchmarkStage>(stage), shape, trace);
+                    best = best < 0 ? seconds : min(best, seconds);
+                }
+                results.push_back({BENCHMARK_STAGE_NAMES[stage], tracePatternName(pattern), shape.name, accesses, best});
+            }
+        }
+    }
+
+    cout << "label,stage,pattern,shape,accesses,seconds,accesses_per_second" << endl;
+    int regressions = 0;
+    for (const BenchmarkResult &result : results)
+    {
+        double rate = result.seconds > 0 ? result.accesses / result.seconds : 0;
+        cout << label << "," << result.stage << "," << result.pattern << "," << result.shape << "," << result.accesses << ","
+             << fixed << setprecision(6) << result.seconds << "," << setprecision(0) << rate << endl;
+
+        auto previous = baseline.find(BenchmarkKey(result.stage, result.pattern, result.shape));
+        if (previous != baseline.end() && rate < previous->second * (1 - tolerance))
+        {
+            cerr << "Regression: " << result.stage << " " << result.pattern << " " << result.shape << ": " << fixed << setprecision(0)
+                 << rate << " accesses/s against " << previous->second << " (" << setprecision(1)
+                 << 100 * (1 - rate / previous->second) << "% slower)" << endl;
+            regressions++;
+        }
+    }
+    return regressions > 0 ? 2 : 0;
+}
@@ -0,0 +1,177 @@
+#ifndef INTERVALS_H
+#define INTERVALS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "memhier.h"
+
+// Time-series statistics: every interval accesses the simulator's counters are
+// snapshotted with Simulator::stats and the change since the previous snapshot is
+// written as one CSV row or one JSON object per line. Intervals end at multiples of the
+// interval length counted from the start of the trace, so runs resumed from a
+// checkpoint line up with uninterrupted ones; the last interval may be shorter.
+// Rows are formatted into a fixed buffer and written through stdio, so the hot path
+// only compares a counter.
+
+enum IntervalFormat
+{
+    INTERVAL_CSV,
+    INTERVAL_JSON
+};
+
+struct IntervalField
+{
+    const char *name;
+    uint64_t SimulationStats::*count;
+};
+
+// Counters reported for every interval, as their change over the interval.
+const IntervalField INTERVAL_FIELDS[] = {
+    {"dtlb_hits", &SimulationStats::dtlbHits},
+    {"dtlb_misses", &SimulationStats::dtlbMisses},
+    {"pt_hits", &SimulationStats::ptHits},
+    {"pt_faults", &SimulationStats::ptFaults},
+    {"dc_hits", &SimulationStats::dcHits},
+    {"dc_misses", &SimulationStats::dcMisses},
+    {"l2_hits", &SimulationStats::l2Hits},
+    {"l2_misses", &SimulationStats::l2Misses},
+    {"reads", &SimulationStats::totalReads},
+    {"writes", &SimulationStats::totalWrites},
+    {"memory_refs", &SimulationStats::mainMemoryRefs},
+    {"page_table_refs", &SimulationStats::pageTableRefs},
+    {"disk_refs", &SimulationStats::diskRefs},
+    {"dc_write_backs", &SimulationStats::dcWriteBacks},
+    {"l2_write_backs", &SimulationStats::l2WriteBacks},
+    {"coherence_misses", &SimulationStats::coherenceMisses},
+    {"invalidations", &SimulationStats::invalidations},
+    {"upgrades", &SimulationStats::upgrades},
+    {"false_sharing", &SimulationStats::falseSharing},
+    {"page_walks", &SimulationStats::pageWalks},
+    {"pte_reads", &SimulationStats::pteReads},
+};
+
+const size_t INTERVAL_ROW_SIZE = 1024;
+
+struct IntervalWriter
+{
+    FILE *file = nullptr;
+    IntervalFormat format = INTERVAL_CSV;
+    uint64_t length = 0;
+    uint64_t start = 0;        // access the open interval began at
+    uint64_t nextBoundary = 0; // access the open interval ends before
+    uint64_t index = 0;
+    SimulationStats previous;
+};
+
+// Picks JSON lines for .json and .jsonl files and CSV otherwise.
+inline IntervalFormat intervalFormatFor(const std::string &filename)
+{
+    size_t dot = filename.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : filename.substr(dot);
+    return extension == ".json" || extension == ".jsonl" ? INTERVAL_JSON : INTERVAL_CSV;
+}
+
+// accesses is the number of trace records simulated before the first interval, and
+// stats the counters at that point.
+inline bool openIntervalWriter(IntervalWriter &writer, const std::string &filename, uint64_t length, uint64_t accesses,
+                               const SimulationStats &stats)
+{
+    writer.file = fopen(filename.c_str(), "w");
+    if (writer.file == nullptr)
+    {
+        std::cerr << "Error: Unable to open interval statistics file " << filename << "." << std::endl;
+        return false;
+    }
+    writer.format = intervalFormatFor(filename);
+    writer.length = length;
+    writer.start = accesses;
+    writer.nextBoundary = (accesses / length + 1) * length;
+    writer.index = accesses / length;
+    writer.previous = stats;
+    if (writer.format == INTERVAL_CSV)
+    {
+        fputs("interval,first_access,accesses", writer.file);
+        for (const IntervalField &field : INTERVAL_FIELDS)
+            fprintf(writer.file, ",%s", field.name);
+        fputs(",cycles,dtlb_hit_ratio,pt_hit_ratio,dc_hit_ratio,l2_hit_ratio,amat\n", writer.file);
+    }
+    return true;
+}
+
+inline double intervalRatio(uint64_t hits, uint64_t misses)
+{
+    return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0;
+}
+
+inline void appendIntervalCount(char *row, size_t &used, bool json, const char *name, long long value)
+{
+    int length = json ? snprintf(row + used, INTERVAL_ROW_SIZE - used, ",\"%s\":%lld", name, value)
+                      : snprintf(row + used, INTERVAL_ROW_SIZE - used, ",%lld", value);
+    used = std::min(used + std::max(length, 0), INTERVAL_ROW_SIZE - 1);
+}
+
+inline void appendIntervalRatio(char *row, size_t &used, bool json, const char *name, double value)
+{
+    int length = json ? snprintf(row + used, INTERVAL_ROW_SIZE - used, ",\"%s\":%.6f", name, value)
+                      : snprintf(row + used, INTERVAL_ROW_SIZE - used, ",%.6f", value);
+    used = std::min(used + std::max(length, 0), INTERVAL_ROW_SIZE - 1);
+}
+
+// Writes the interval from writer.start up to accesses, whose counters are now stats.
+inline void writeInterval(IntervalWriter &writer, const SimulationStats &stats, uint64_t accesses)
+{
+    const SimulationStats &previous = writer.previous;
+    bool json = writer.format == INTERVAL_JSON;
+    char row[INTERVAL_ROW_SIZE];
+    uint64_t count = accesses - writer.start;
+    int length = snprintf(row, sizeof(row), json ? "{\"interval\":%llu,\"first_access\":%llu,\"accesses\":%llu" : "%llu,%llu,%llu",
+                          static_cast<unsigned long long>(writer.index), static_cast<unsigned long long>(writer.start),
+                          static_cast<unsigned long long>(count));
+    size_t used = static_cast<size_t>(std::max(length, 0));
+    for (const IntervalField &field : INTERVAL_FIELDS)
+    {
+        appendIntervalCount(row, used, json, field.name, static_cast<long long>(stats.*field.count - previous.*field.count));
+    }
+    uint64_t cycles = stats.totalCycles - previous.totalCycles;
+    appendIntervalCount(row, used, json, "cycles", static_cast<long long>(cycles));
+    appendIntervalRatio(row, used, json, "dtlb_hit_ratio", intervalRatio(stats.dtlbHits - previous.dtlbHits, stats.dtlbMisses - previous.dtlbMisses));
+    appendIntervalRatio(row, used, json, "pt_hit_ratio", intervalRatio(stats.ptHits - previous.ptHits, stats.ptFaults - previous.ptFaults));
+    appendIntervalRatio(row, used, json, "dc_hit_ratio", intervalRatio(stats.dcHits - previous.dcHits, stats.dcMisses - previous.dcMisses));
+    appendIntervalRatio(row, used, json, "l2_hit_ratio", intervalRatio(stats.l2Hits - previous.l2Hits, stats.l2Misses - previous.l2Misses));
+    appendIntervalRatio(row, used, json, "amat", count > 0 ? static_cast<double>(cycles) / count : 0);
+    fwrite(row, 1, used, writer.file);
+    fputs(json ? "}\n" : "\n", writer.file);
+
+    writer.previous = stats;
+    writer.start = accesses;
+    writer.nextBoundary = accesses + writer.length;
+    writer.index++;
+}
+
+// Call after every access; accesses counts the trace records simulated so far.
+inline void intervalTick(IntervalWriter &writer, const Simulator &simulator, uint64_t accesses)
+{
+    if (writer.file != nullptr && accesses == writer.nextBoundary)
+    {
+        writeInterval(writer, simulator.stats(), accesses);
+    }
+}
+
+// Writes the last, partial interval if it has any accesses and closes the file.
+inline void closeIntervalWriter(IntervalWriter &writer, const Simulator &simulator, uint64_t accesses)
+{
+    if (writer.file == nullptr)
+        return;
+    if (accesses > writer.start)
+    {
+        writeInterval(writer, simulator.stats(), accesses);
+    }
+    fclose(writer.file);
+    writer.file = nullptr;
+}
+
+#endif
@@ -1,1152 +1,1007 @@
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <vector>
 #include <iomanip>
-#include <cmath>
-#include <deque>
-#include <bitset>
-#include <map>
-#include <limits>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "memhier.h"
+#include "tracefile.h"
+#include "report.h"
+#include "stackdistance.h"
+#include "sampling.h"
+#include "intervals.h"
+#include "results.h"
+#include "profile.h"
 
 using namespace std;
 
-const int POSITIVE_INFINITY = numeric_limits<int>::max();
-
-struct DataTLBConfig
-{
-    int numSets;
-    int setSize;
-};
-
-struct DataCacheConfig
-{
-    int numSets;
-    int setSize;
-    int lineSize;
-    bool writeThroughOrNoWriteAllocate;
-};
-
-struct L2CacheConfig
-{
-    int numSets;
-    int setSize;
-    int lineSize;
-};
-
-struct MemoryConfig
-{
-    int numVirtualPages;
-    int numPhysicalPages;
-    int pageSize;
-};
-
-struct Configuration
-{
-    DataTLBConfig dtlbConfig;
-    MemoryConfig ptConfig;
-    DataCacheConfig dcConfig;
-    L2CacheConfig l2Config;
-    bool useVirtualAddresses;
-    bool useTLB;
-    bool useL2Cache;
-} config;
-
-struct TLBData
-{
-    int tag;
-    int physicalPageNumber;
-    bool valid;
-    int index;
-    int count;
+const size_t SWEEP_BATCH_SIZE = 1 << 16;
+const int MRC_MAX_SETS = 1024;
+const size_t PIPELINE_BATCH_SIZE = 4096;
+const size_t PIPELINE_BATCHES = 8; // power of two, the capacity of every ring
+
+// Work shared between the sweep's main thread and its workers. Worker w simulates
+// configurations w, w + threadCount, ... over the current batch.
+struct SweepPool
+{
+    vector<Simulator> *simulators = nullptr;
+    int threadCount = 1;
+    const vector<TraceRecord> *batch = nullptr;
+    int generation = 0;
+    int pending = 0;
+    bool stopping = false;
+    mutex lock;
+    condition_variable batchReady;
+    condition_variable batchDone;
 };
 
-struct Cache
+void sweepWorker(SweepPool &pool, int worker)
 {
-    int tag;
-    bool valid;
-    int physicalPage;
-    int index;
-    int count;
-};
-
-struct Page
-{
-    bool dirty;
-    int physicalPage;
-    int index;
-    int virtualPage;
-    int valid;
-    int count;
-};
-
-struct TraceData
-{
-    int virtualAddress = -1;
-    int virtualPage = -1;
-    int pageOffset = -1;
-    int tlbTag = -1;
-    int tlbIndex = -1;
-    char tlbRes[10];
-    char ptRes[10];
-    int physicalPage = -1;
-    int dcTag = -1;
-    int dcIndex = -1;
-    char dcRes[10];
-    int l2Tag = -1;
-    int l2Index = -1;
-    char l2Res[10];
-};
-
-struct DCSet
-{
-    int setIndex;
-    bool dirty;
-    vector<Cache> dcList;
-};
-
-struct L2Set
-{
-    int setIndex;
-    bool dirty;
-    vector<Cache> l2CacheList;
-};
-struct TLBSet
-{
-    int setIndex;
-    vector<TLBData> tlbDataList;
-};
-
-vector<Page> pageTableList; // Page Table
-vector<TraceData> traceDataList;
-vector<DCSet> dcSetsList;
-vector<L2Set> l2SetsList;
-vector<TLBSet> tlbSetsList;
-
-int ptHits = 0;
-int ptFaults = 0;
-int dcHits = 0;
-int dcMisses = 0;
-int l2Hits = 0;
-int l2Misses = 0;
-int totalReads = 0;
-int totalWrites = 0;
-double ratioOfReads = 0;
-int mainMemoryRefs = 0;
-int pageTableRefs = 0;
-int diskRefs = 0;
-int dtlbHits = 0;
-int dtlbMisses = 0;
-double dtlbHitRatio = 0;
-double ptHitRatio = 0;
-double dcHitRatio = 0;
-double l2HitRatio = 0;
-int pageOffSetBits, VPNBits, indexBits, tagBits, totalBits, physicalPageBits;
-int dcIndexBits, dcOffsetBits, dcTagBits, dcTotalBits;
-int l2IndexBits, l2OffsetBits, l2TagBits, l2TotalBits;
-const int MAX_BITS = 32;
-int currenPhysicalPageAddress = -1;
-int trace = 0;
-
-TraceData initTrace()
-{
-    TraceData traceData;
-    traceData.tlbRes[0] = '\0';
-    traceData.ptRes[0] = '\0';
-    traceData.dcRes[0] = '\0';
-    traceData.l2Res[0] = '\0';
-    return traceData;
-}
-
-int concatBits(int value1, int value2)
-{
-    // Convert integers to binary strings
-    bitset<MAX_BITS / 2> binaryValue1(value1);
-    bitset<MAX_BITS / 2> binaryValue2(value2);
-    // cout<<binaryValue1.to_string()<<endl;
-    // cout<<binaryValue2.to_string()<<endl;
-
-    // Concatenate integers
-    string binaryString1 = binaryValue1.to_string();
-    binaryString1.erase(0, binaryString1.find_first_not_of('0'));
-
-    string binaryString2 = binaryValue2.to_string();
-    binaryString2.erase(0, binaryString2.find_first_not_of('0'));
-
-    // Concatenate binary strings
-    string concatenatedBinary = binaryString1 + binaryString2;
-    // cout<<concatenatedBinary<<endl;
-    // Convert concatenated binary string to an integer
-    int result = std::bitset<MAX_BITS>(concatenatedBinary).to_ulong();
-
-    return result;
-}
-
-int concatAsHex(string hexValue1, string hexValue2)
-{
-    string concatenatedHex = hexValue1 + hexValue2;
+    int seenGeneration = 0;
+    while (true)
+    {
+        const vector<TraceRecord> *batch;
+        {
+            unique_lock<mutex> guard(pool.lock);
+            while (!pool.stopping && pool.generation == seenGeneration)
+            {
+                pool.batchReady.wait(guard);
+            }
+            if (pool.stopping)
+            {
+                return;
+            }
+            seenGeneration = pool.generation;
+            batch = pool.batch;
+        }
 
-    // Convert concatenated hex string to an integer
-    int result;
-    istringstream(concatenatedHex) >> hex >> result;
+        vector<Simulator> &simulators = *pool.simulators;
+        for (size_t i = worker; i < simulators.size(); i += pool.threadCount)
+        {
+            for (const TraceRecord &record : *batch)
+            {
+                simulators[i].simulateMemoryAccess(record.address, record.accessType, record.core);
+            }
+        }
 
-    return result;
+        lock_guard<mutex> guard(pool.lock);
+        if (--pool.pending == 0)
+        {
+            pool.batchDone.notify_one();
+        }
+    }
 }
 
-string convertHex(int value, int offSet)
+void readTraceBatch(TraceReader &reader, vector<TraceRecord> &batch)
 {
-    if (offSet == 0)
+    batch.clear();
+    TraceRecord record;
+    while (batch.size() < SWEEP_BATCH_SIZE && nextTraceRecord(reader, record))
     {
-        offSet = 1;
+        batch.push_back(record);
     }
-    ostringstream stream;
-    stream << hex << std::setw(offSet) << setfill('0') << value;
-    return stream.str();
 }
 
-template <typename T>
-int LRU(const std::vector<T> &list)
+// Simulates every configuration over one pass of the trace. Each record is decoded once;
+// the main thread decodes the next batch while the workers simulate the current one.
+void runSweep(vector<Simulator> &simulators, TraceReader &reader, int threadCount)
 {
-    int index = 0;
-    int lruIndex = 0;
-    int minValue = POSITIVE_INFINITY;
-    for (const auto &item : list)
+    SweepPool pool;
+    pool.simulators = &simulators;
+    pool.threadCount = threadCount;
+    vector<thread> workers;
+    for (int i = 0; i < threadCount; i++)
     {
-        if (minValue > item.count)
-        {
-            minValue = item.count;
-            lruIndex = index;
-        }
-        index++;
+        workers.push_back(thread(sweepWorker, ref(pool), i));
     }
-    return lruIndex;
-}
-
-void calculateBits()
-{
-    pageOffSetBits = log2(config.ptConfig.pageSize);
-    indexBits = log2(config.dtlbConfig.numSets);
-    totalBits = log2(config.ptConfig.numPhysicalPages * config.ptConfig.numVirtualPages * config.ptConfig.pageSize); // virtual
-    tagBits = totalBits - pageOffSetBits - indexBits;
-    VPNBits = tagBits + indexBits;
-    physicalPageBits = log2(config.ptConfig.numVirtualPages);
-
-    // DC
-    dcIndexBits = log2(config.dcConfig.numSets);
-    dcOffsetBits = log2(config.dcConfig.lineSize);
-    dcTotalBits = log2(config.ptConfig.numPhysicalPages * config.ptConfig.pageSize);
-    dcTagBits = dcTotalBits - dcIndexBits - dcOffsetBits;
-    // cout<<"dcOffsetBits: "<<dcOffsetBits<<endl;
-    // cout<<"dcIndexBits :"<<dcIndexBits<<endl;
-    // cout<<"dcTagBits: "<<dcTagBits<<endl;
-    // cout<<"dcTotalBits :"<<dcTotalBits<<endl;
-
-    // L2
-    l2IndexBits = log2(config.l2Config.numSets);
-    l2OffsetBits = log2(config.l2Config.lineSize);
-    l2TotalBits = log2(config.ptConfig.numPhysicalPages * config.ptConfig.pageSize);
-    l2TagBits = l2TotalBits - l2IndexBits - l2OffsetBits;
-    // cout<<"l2OffsetBits: "<<dec<<l2OffsetBits<<endl;
-    // cout<<"l2IndexBits :"<<l2IndexBits<<endl;
-    // cout<<"l2TagBits: "<<l2TagBits<<endl;
-    // cout<<"l2TotalBits :"<<l2TotalBits<<endl;
-}
 
-Configuration readConfigFile(const string &filename)
-{
-    ifstream file(filename);
-    Configuration config;
-    string line;
-    string currentData;
-    if (file.is_open())
+    vector<TraceRecord> batches[2];
+    int current = 0;
+    readTraceBatch(reader, batches[current]);
+    while (!batches[current].empty())
     {
-
-        while (getline(file, line))
         {
-            if (line.find(':') != string::npos)
-            {
-                istringstream iss(line);
-                string key, value;
-                getline(iss, key, ':');
-                getline(iss, value);
-
-                key.erase(0, key.find_first_not_of(" \t"));
-                key.erase(key.find_last_not_of(" \t") + 1);
-                value.erase(0, value.find_first_not_of(" \t"));
-                value.erase(value.find_last_not_of(" \t") + 1);
+            lock_guard<mutex> guard(pool.lock);
+            pool.batch = &batches[current];
+            pool.pending = threadCount;
+            pool.generation++;
+        }
+        pool.batchReady.notify_all();
+        readTraceBatch(reader, batches[1 - current]);
 
-                if (currentData.find("Data TLB configuration") != string::npos)
-                {
-                    if (key == "Number of sets")
-                    {
-                        config.dtlbConfig.numSets = stoi(value);
-                    }
-                    else if (key == "Set size")
-                    {
-                        config.dtlbConfig.setSize = stoi(value);
-                    }
-                }
-                else if (currentData.find("Page Table configuration") != string::npos)
-                {
-                    if (key == "Number of virtual pages")
-                    {
-                        config.ptConfig.numVirtualPages = stoi(value);
-                    }
-                    else if (key == "Number of physical pages")
-                    {
-                        config.ptConfig.numPhysicalPages = stoi(value);
-                    }
-                    else if (key == "Page size")
-                    {
-                        config.ptConfig.pageSize = stoi(value);
-                    }
-                }
-                else if (currentData.find("Data Cache configuration") != string::npos)
-                {
-                    if (key == "Number of sets")
-                    {
-                        config.dcConfig.numSets = stoi(value);
-                    }
-                    else if (key == "Set size")
-                    {
-                        config.dcConfig.setSize = stoi(value);
-                    }
-                    else if (key == "Line size")
-                    {
-                        config.dcConfig.lineSize = stoi(value);
-                    }
-                    else if (key == "Write through/no write allocate")
-                    {
-                        config.dcConfig.writeThroughOrNoWriteAllocate = (value == "y");
-                    }
-                }
-                else if (currentData.find("L2 Cache configuration") != string::npos)
-                {
-                    if (key == "Number of sets")
-                    {
-                        config.l2Config.numSets = stoi(value);
-                    }
-                    else if (key == "Set size")
-                    {
-                        config.l2Config.setSize = stoi(value);
-                    }
-                    else if (key == "Line size")
-                    {
-                        config.l2Config.lineSize = stoi(value);
-                        currentData = "";
-                    }
-                }
-                else
-                {
-                    if (key == "Virtual addresses")
-                    {
-                        config.useVirtualAddresses = (value == "y");
-                    }
-                    else if (key == "TLB")
-                    {
-                        config.useTLB = (value == "y");
-                    }
-                    else if (key == "L2 cache")
-                    {
-                        config.useL2Cache = (value == "y");
-                    }
-                }
-            }
-            else if (line.size() > 0)
-            {
-                currentData = line;
-            }
+        unique_lock<mutex> guard(pool.lock);
+        while (pool.pending > 0)
+        {
+            pool.batchDone.wait(guard);
         }
+        current = 1 - current;
+    }
 
-        file.close();
+    {
+        lock_guard<mutex> guard(pool.lock);
+        pool.stopping = true;
     }
-    else
+    pool.batchReady.notify_all();
+    for (thread &worker : workers)
     {
-        cerr << "Error: Unable to open trace file." << endl;
+        worker.join();
     }
-    return config;
 }
 
-vector<string> readTraceFile(const string &traceFile)
+// Final statistics of every configuration, one column per configuration.
+void printSweepStatistics(ostream &out, const vector<string> &names, const vector<Simulator> &simulators)
 {
-    vector<string> traceData;
-    ifstream file(traceFile);
-    if (file.is_open())
+    const int columnWidth = 16;
+    out << endl
+        << "Sweep statistics" << endl
+        << endl;
+    out << left << setw(17) << "configuration" << ":";
+    for (const string &name : names)
+    {
+        string shortName = name.substr(name.find_last_of("/\\") + 1);
+        out << right << setw(columnWidth) << shortName.substr(0, columnWidth - 1);
+    }
+    out << endl;
+
+    struct Row
+    {
+        const char *label;
+        uint64_t Simulator::*count;
+    };
+    const Row countRows[] = {
+        {"dtlb hits", &Simulator::dtlbHits},
+        {"dtlb misses", &Simulator::dtlbMisses},
+        {"pt hits", &Simulator::ptHits},
+        {"pt faults", &Simulator::ptFaults},
+        {"dc hits", &Simulator::dcHits},
+        {"dc misses", &Simulator::dcMisses},
+        {"L2 hits", &Simulator::l2Hits},
+        {"L2 misses", &Simulator::l2Misses},
+        {"Total reads", &Simulator::totalReads},
+        {"Total writes", &Simulator::totalWrites},
+        {"main memory refs", &Simulator::mainMemoryRefs},
+        {"page table refs", &Simulator::pageTableRefs},
+        {"disk refs", &Simulator::diskRefs},
+        {"dc write-backs", &Simulator::dcWriteBacks},
+        {"L2 write-backs", &Simulator::l2WriteBacks},
+    };
+    for (const Row &row : countRows)
     {
-        string line;
-        while (getline(file, line))
+        out << left << setw(17) << row.label << ":";
+        for (const Simulator &simulator : simulators)
         {
-            traceData.push_back(line);
+            out << right << setw(columnWidth) << simulator.*row.count;
         }
-        file.close();
+        out << endl;
     }
-    else
+
+    const char *ratioLabels[] = {"dtlb hit ratio", "pt hit ratio", "dc hit ratio", "L2 hit ratio", "Ratio of reads", "AMAT (cycles)"};
+    for (int row = 0; row < 6; row++)
     {
-        cerr << "Error: Unable to open trace file." << endl;
+        out << left << setw(17) << ratioLabels[row] << ":";
+        for (const Simulator &simulator : simulators)
+        {
+            double ratio = 0;
+            switch (row)
+            {
+            case 0:
+                ratio = hitRatio(simulator.dtlbHits, simulator.dtlbMisses);
+                break;
+            case 1:
+                ratio = hitRatio(simulator.ptHits, simulator.ptFaults);
+                break;
+            case 2:
+                ratio = hitRatio(simulator.dcHits, simulator.dcMisses);
+                break;
+            case 3:
+                ratio = hitRatio(simulator.l2Hits, simulator.l2Misses);
+                break;
+            case 4:
+                ratio = hitRatio(simulator.totalReads, simulator.totalWrites);
+                break;
+            default:
+                ratio = simulator.stats().amat;
+                break;
+            }
+            out << right << setw(columnWidth) << fixed << setprecision(6) << ratio;
+        }
+        out << endl;
     }
-    return traceData;
-}
-
-void printDataTLBConfig(const DataTLBConfig &tlbConfig)
-{
-    cout << "Number of Sets: " << tlbConfig.numSets << endl;
-    cout << "Set Size: " << tlbConfig.setSize << endl;
-}
-
-void printDataCacheConfig(const DataCacheConfig &cacheConfig)
-{
-    cout << "Number of Sets: " << cacheConfig.numSets << endl;
-    cout << "Set Size: " << cacheConfig.setSize << endl;
-    cout << "Line Size: " << cacheConfig.lineSize << endl;
-    cout << "write Through Or No Write Allocate: " << (cacheConfig.writeThroughOrNoWriteAllocate ? "yes" : "no") << endl;
 }
 
-void printL2CacheConfig(const L2CacheConfig &cacheConfig)
+// What happens to each simulated row: it is printed unless the report is stats-only,
+// and it feeds the miss ratio curves when they are requested.
+struct RowSink
 {
-    cout << "Number of Sets: " << cacheConfig.numSets << endl;
-    cout << "Set Size: " << cacheConfig.setSize << endl;
-    cout << "Line Size: " << cacheConfig.lineSize << endl;
-}
-
-void printMemoryConfig(const MemoryConfig &memoryConfig)
-{
-    cout << "Number of Virtual Pages: " << memoryConfig.numVirtualPages << endl;
-    cout << "Number of Physical Pages: " << memoryConfig.numPhysicalPages << endl;
-    cout << "Page Size: " << memoryConfig.pageSize << endl;
-}
-
-void printConfiguration()
-{
-    cout << "Data TLB configuration:" << endl;
-    printDataTLBConfig(config.dtlbConfig);
-
-    cout << "Page Table configuration:" << endl;
-    printMemoryConfig(config.ptConfig);
-
-    cout << "Data Cache configuration:" << endl;
-    printDataCacheConfig(config.dcConfig);
-
-    cout << "L2 Cache configuration:" << endl;
-    printL2CacheConfig(config.l2Config);
-
-    cout << "Addresses: " << (config.useVirtualAddresses ? "virtual" : "physical") << endl;
-    cout << "TLB: " << (config.useTLB ? "yes" : "no") << endl;
-    cout << "L2 Cache: " << (config.useL2Cache ? "yes" : "no") << endl;
-}
+    ReportWriter *report = nullptr;
+    ResultRowsWriter *rows = nullptr;
+    StackDistanceProfile *dcProfile = nullptr;
+    StackDistanceProfile *l2Profile = nullptr;
+    int dcIndexBits = 0;
+    int l2IndexBits = 0;
+};
 
-void printDTLB()
+void consumeRow(RowSink &sink, const TraceData &row)
 {
-    cout << "DTLB Data" << endl;
-    for (TLBSet tlbSet : tlbSetsList)
+    PROFILE_SCOPE(PROFILE_REPORT);
+    if (sink.report != nullptr)
     {
-        cout << "Set: " << tlbSet.setIndex << endl;
-        for (TLBData tlbData : tlbSet.tlbDataList)
-        {
-            cout << " inex: " << tlbData.index << " VPN: " << hex << concatBits(tlbData.tag, tlbData.index) << " PP: "
-                 << " " << tlbData.physicalPageNumber << endl;
-        }
+        printTraceData(*sink.report, row);
     }
-}
-
-void printPageTable()
-{
-    cout << "Page Table Data" << endl;
-    for (Page page : pageTableList)
+    if (sink.rows != nullptr)
     {
-        cout << " physicalPage: " << page.physicalPage << " VPN: " << page.virtualPage << " count:" << page.count << endl;
+        writeResultRow(*sink.rows, row);
     }
-}
-
-void printDC()
-{
-    cout << endl
-         << "DC DATA" << endl;
-    for (DCSet dcSet : dcSetsList)
+    if (sink.dcProfile != nullptr)
     {
-        cout << "set : " << dcSet.setIndex << endl;
-        for (Cache dcData : dcSet.dcList)
+        // Lines are rebuilt from tag and set so they wrap the way the caches see them
+        recordStackAccess(*sink.dcProfile, (static_cast<uint64_t>(row.dcTag) << sink.dcIndexBits) | row.dcIndex);
+        if (row.l2Index >= 0)
         {
-            cout << " dc: " << dcData.index << " tag: " << dcData.tag << " count:" << dcData.count << endl;
+            recordStackAccess(*sink.l2Profile, (static_cast<uint64_t>(row.l2Tag) << sink.l2IndexBits) | row.l2Index);
         }
     }
 }
 
-void printSimulationStatistics()
+// Bounded single-producer/single-consumer queue. Each index is advanced by one side
+// only, so neither side takes a lock; the two indices live on separate cache lines.
+template <typename T>
+struct SpscRing
 {
-    dtlbHitRatio = (dtlbHits + dtlbMisses) > 0 ? static_cast<double>(dtlbHits) / (dtlbHits + dtlbMisses) : 0;
-    ptHitRatio = (ptHits + ptFaults) > 0 ? static_cast<double>(ptHits) / (ptHits + ptFaults) : 0;
-    dcHitRatio = (dcHits + dcMisses) > 0 ? static_cast<double>(dcHits) / (dcHits + dcMisses) : 0;
-    l2HitRatio = (l2Hits + l2Misses) > 0 ? static_cast<double>(l2Hits) / (l2Hits + l2Misses) : 0;
-    ratioOfReads = (totalReads + totalWrites) > 0 ? static_cast<double>(totalReads) / (totalReads + totalWrites) : 0;
-
-    // cout << endl<< "Simulation statistics" << endl<<endl;
-    // cout << "dtlb hits : " << dtlbHits << endl;
-    // cout << "dtlb misses : " << dtlbMisses << endl;
-    // cout << "dtlb hit ratio : " << fixed << setprecision(6) << dtlbHitRatio << endl<< endl;
-    // cout << "pt hits : " << ptHits << endl;
-    // cout << "pt faults : " << ptFaults << endl;
-    // cout << "pt hit ratio : " << fixed << setprecision(6) << ptHitRatio << endl<< endl;
-    // cout << "dc hits : " << dcHits << endl;
-    // cout << "dc misses : " << dcMisses << endl;
-    // cout << "dc hit ratio : " << fixed << setprecision(6) << dcHitRatio << endl<< endl;
-    // cout << "L2 hits : " << l2Hits << endl;
-    // cout << "L2 misses : " << l2Misses << endl;
-    // cout << "L2 hit ratio : " << fixed << setprecision(6) << l2HitRatio << endl<< endl;
-    // cout << "Total reads : " << totalReads << endl;
-    // cout << "Total writes : " << totalWrites << endl;
-    // cout << "Ratio of reads : " << fixed << setprecision(6) << ratioOfReads << endl<< endl;
-    // cout << "main memory refs : " << mainMemoryRefs << endl;
-    // cout << "page table refs : " << pageTableRefs << endl;
-    // cout << "disk refs : " << diskRefs << endl;
+    vector<T> slots;
+    size_t mask = 0;
+    alignas(CACHE_LINE_SIZE) atomic<size_t> head{0}; // next slot to pop, advanced by the consumer
+    alignas(CACHE_LINE_SIZE) atomic<size_t> tail{0}; // next slot to push, advanced by the producer
+};
 
-    cout << endl
-         << "Simulation statistics" << endl
-         << endl;
-    cout << left << setw(17) << "dtlb hits"
-         << ": " << dtlbHits << endl;
-    cout << left << setw(17) << "dtlb misses"
-         << ": " << dtlbMisses << endl;
-    cout << left << setw(17) << "dtlb hit ratio"
-         << ": " << fixed << setprecision(6) << dtlbHitRatio << endl
-         << endl;
-    cout << left << setw(17) << "pt hits"
-         << ": " << ptHits << endl;
-    cout << left << setw(17) << "pt faults"
-         << ": " << ptFaults << endl;
-    cout << left << setw(17) << "pt hit ratio"
-         << ": " << fixed << setprecision(6) << ptHitRatio << endl
-         << endl;
-    cout << left << setw(17) << "dc hits"
-         << ": " << dcHits << endl;
-    cout << left << setw(17) << "dc misses"
-         << ": " << dcMisses << endl;
-    cout << left << setw(17) << "dc hit ratio"
-         << ": " << fixed << setprecision(6) << dcHitRatio << endl
-         << endl;
-    cout << left << setw(17) << "L2 hits"
-         << ": " << l2Hits << endl;
-    cout << left << setw(17) << "L2 misses"
-         << ": " << l2Misses << endl;
-    cout << left << setw(17) << "L2 hit ratio"
-         << ": " << fixed << setprecision(6) << l2HitRatio << endl
-         << endl;
-    cout << left << setw(17) << "Total reads"
-         << ": " << totalReads << endl;
-    cout << left << setw(17) << "Total writes"
-         << ": " << totalWrites << endl;
-    cout << left << setw(17) << "Ratio of reads"
-         << ": " << fixed << setprecision(6) << ratioOfReads << endl
-         << endl;
-    cout << left << setw(17) << "main memory refs"
-         << ": " << mainMemoryRefs << endl;
-    cout << left << setw(17) << "page table refs"
-         << ": " << pageTableRefs << endl;
-    cout << left << setw(17) << "disk refs"
-         << ": " << diskRefs << endl;
+// capacity must be a power of two
+template <typename T>
+void initSpscRing(SpscRing<T> &ring, size_t capacity)
+{
+    ring.slots.assign(capacity, T());
+    ring.mask = capacity - 1;
+    ring.head.store(0);
+    ring.tail.store(0);
 }
 
-void printConfig()
+template <typename T>
+bool spscTryPush(SpscRing<T> &ring, const T &value)
 {
-
-    cout << "Data TLB contains " << config.dtlbConfig.numSets << " sets." << endl;
-    cout << "Each set contains " << config.dtlbConfig.setSize << " entries." << endl;
-    cout << "Number of bits used for the index is " << indexBits << "." << endl
-         << endl;
-
-    cout << "Number of virtual pages is " << config.ptConfig.numVirtualPages << "." << endl;
-    cout << "Number of physical pages is " << config.ptConfig.numPhysicalPages << "." << endl;
-    cout << "Each page contains " << config.ptConfig.pageSize << " bytes." << endl;
-    cout << "Number of bits used for the page table index is " << physicalPageBits << "." << endl;
-    cout << "Number of bits used for the page offset is " << pageOffSetBits << "." << endl
-         << endl;
-
-    cout << "D-cache contains " << config.dcConfig.numSets << " sets." << endl;
-    cout << "Each set contains " << config.dcConfig.setSize << " entries." << endl;
-    cout << "Each line is " << config.dcConfig.lineSize << " bytes." << endl;
-    if (config.dcConfig.writeThroughOrNoWriteAllocate == 1)
+    size_t tail = ring.tail.load(memory_order_relaxed);
+    if (tail - ring.head.load(memory_order_acquire) == ring.slots.size())
     {
-        cout << "The cache uses a no write-allocate and write-through policy." << endl;
+        return false;
     }
-    cout << "Number of bits used for the index is " << dcIndexBits << "." << endl;
-    cout << "Number of bits used for the offset is " << dcOffsetBits << "." << endl
-         << endl;
+    ring.slots[tail & ring.mask] = value;
+    ring.tail.store(tail + 1, memory_order_release);
+    return true;
+}
 
-    cout << "L2-cache contains " << config.l2Config.numSets << " sets." << endl;
-    cout << "Each set contains " << config.l2Config.setSize << " entries." << endl;
-    cout << "Each line is " << config.l2Config.lineSize << " bytes." << endl;
-    cout << "Number of bits used for the index is " << l2IndexBits << "." << endl;
-    cout << "Number of bits used for the offset is " << l2OffsetBits << "." << endl
-         << endl;
-    if (config.useVirtualAddresses == 1)
+template <typename T>
+bool spscTryPop(SpscRing<T> &ring, T &value)
+{
+    size_t head = ring.head.load(memory_order_relaxed);
+    if (ring.tail.load(memory_order_acquire) == head)
     {
-        cout << "The addresses read in are virtual addresses." << endl
-             << endl;
+        return false;
     }
-    else
+    value = ring.slots[head & ring.mask];
+    ring.head.store(head + 1, memory_order_release);
+    return true;
+}
+
+// A stage only waits while its neighbour is behind, so it yields instead of sleeping.
+template <typename T>
+void spscPush(SpscRing<T> &ring, const T &value)
+{
+    while (!spscTryPush(ring, value))
     {
-        cout << "The addresses read in are physical addresses." << endl
-             << endl;
+        this_thread::yield();
     }
 }
 
-void printTraceData(FILE *file)
+template <typename T>
+T spscPop(SpscRing<T> &ring)
 {
-    size_t arraySize = traceDataList.size();
-    for (size_t i = 0; i < arraySize; ++i)
+    T value;
+    while (!spscTryPop(ring, value))
     {
-        // printf("%08x %6x %4x %8x %3x %4s %4s %3x %8x %3x %4s %8x %3x %4s\n",
-        //        traceDataList[i].virtualAddress, traceDataList[i].virtualPage, traceDataList[i].pageOffset,
-        //        traceDataList[i].tlbTag, traceDataList[i].tlbIndex, traceDataList[i].tlbRes, traceDataList[i].ptRes,
-        //        traceDataList[i].physicalPage, traceDataList[i].dcTag, traceDataList[i].dcIndex, traceDataList[i].dcRes,
-        //        traceDataList[i].l2Tag, traceDataList[i].l2Index, traceDataList[i].l2Res);
-        char formattedVirtualAddress[9];
-        char formattedVirtualPage[7];
-        char formattedPageOffset[5];
-        char formattedTlbTag[9];
-        char formattedTlbIndex[4];
-        char formattedTlbRes[5];
-        char formattedPtRes[5];
-        char formattedPhysicalPage[4];
-        char formattedDcTag[9];
-        char formattedDcIndex[4];
-        char formattedDcRes[5];
-        char formattedL2Tag[9];
-        char formattedL2Index[4];
-        char formattedL2Res[5];
-        // %08x %6x %4x %6x %3x %4s %4s %4x %6x %3x %4s %6x %3x %4s
-        // Format each field using snprintf
-        snprintf(formattedVirtualAddress, sizeof(formattedVirtualAddress), "%08x", traceDataList[i].virtualAddress);
-        snprintf(formattedVirtualPage, sizeof(formattedVirtualPage), traceDataList[i].virtualPage >= 0 ? "%6x" : "", traceDataList[i].virtualPage);
-        snprintf(formattedPageOffset, sizeof(formattedPageOffset), traceDataList[i].pageOffset >= 0 ? "%4x" : "", traceDataList[i].pageOffset);
-        snprintf(formattedTlbTag, sizeof(formattedTlbTag), traceDataList[i].tlbTag >= 0 ? "%6x" : "", traceDataList[i].tlbTag);
-        snprintf(formattedTlbIndex, sizeof(formattedTlbIndex), traceDataList[i].tlbIndex >= 0 ? "%3x" : "", traceDataList[i].tlbIndex);
-        snprintf(formattedTlbRes, sizeof(formattedTlbRes), traceDataList[i].tlbRes[0] != '\0' ? "%s" : "", traceDataList[i].tlbRes);
-        snprintf(formattedPtRes, sizeof(formattedPtRes), traceDataList[i].ptRes[0] != '\0' ? "%s" : "", traceDataList[i].ptRes);
-        snprintf(formattedPhysicalPage, sizeof(formattedPhysicalPage), traceDataList[i].physicalPage >= 0 ? "%4x" : "", traceDataList[i].physicalPage);
-        snprintf(formattedDcTag, sizeof(formattedDcTag), traceDataList[i].dcTag >= 0 ? "%6x" : "", traceDataList[i].dcTag);
-        snprintf(formattedDcIndex, sizeof(formattedDcIndex), traceDataList[i].dcIndex >= 0 ? "%3x" : "", traceDataList[i].dcIndex);
-        snprintf(formattedDcRes, sizeof(formattedDcRes), traceDataList[i].dcRes[0] != '\0' ? "%s" : "", traceDataList[i].dcRes);
-        snprintf(formattedL2Tag, sizeof(formattedL2Tag), traceDataList[i].l2Tag >= 0 ? "%6x" : "", traceDataList[i].l2Tag);
-        snprintf(formattedL2Index, sizeof(formattedL2Index), traceDataList[i].l2Index >= 0 ? "%3x" : "", traceDataList[i].l2Index);
-        // Print all fields
-        fprintf(file, "%s %s %s %s %s %-4s %-4s %4x %s %s %-4s",
-                formattedVirtualAddress,
-                formattedVirtualPage,
-                formattedPageOffset,
-                formattedTlbTag,
-                formattedTlbIndex,
-                formattedTlbRes,
-                formattedPtRes,
-                traceDataList[i].physicalPage,
-                formattedDcTag,
-                formattedDcIndex,
-                formattedDcRes);
-        if (formattedL2Index[0] != '\0')
-            fprintf(file, " %s", formattedL2Tag);
-        if (formattedL2Index[0] != '\0')
-            fprintf(file, " %s", formattedL2Index);
-        fprintf(file, " %s\n", traceDataList[i].l2Res);
+        this_thread::yield();
     }
+    return value;
 }
 
-void printHeader(FILE *file)
+struct PipelineBatch
 {
-    fprintf(file, "Virtual  Virt.  Page TLB    TLB TLB  PT   Phys        DC  DC          L2  L2\n");
-    fprintf(file, "Address  Page # Off  Tag    Ind Res. Res. Pg # DC Tag Ind Res. L2 Tag Ind Res.\n");
-    fprintf(file, "-------- ------ ---- ------ --- ---- ---- ---- ------ --- ---- ------ --- ----\n");
-}
+    vector<TraceRecord> records;
+    vector<uint64_t> physicalAddresses;
+    vector<TraceData> rows;
+    size_t count = 0;
+    bool last = false; // no batch follows this one
+};
 
-int extractBits(int value, int startBit, int endBit, int totalBits)
+// Batches travel parse -> translate -> cache -> report and back to parse through
+// freeBatches, so nothing is allocated once the pipeline is running.
+struct Pipeline
 {
-    bitset<MAX_BITS> binaryValue(value);
-    string result;
-    int paddingZeros = 0;
-    // cout<<value<<endl;
-    // cout<<"total :"<<totalBits<<endl;
-    // cout<<startBit<<" "<<endBit<<endl;
-    // cout<<binaryValue<<endl;
-    if (binaryValue.size() > totalBits)
-    {
-        paddingZeros = binaryValue.size() - totalBits + 1;
-        // cout<<binaryValue.to_string().substr(paddingZeros-1,binaryValue.size())<<endl;
-        result = (binaryValue.to_string().substr(paddingZeros - 1, binaryValue.size())).substr(startBit, endBit - startBit);
-    }
-    else
-    {
-        paddingZeros = totalBits - binaryValue.size();
-        string padding = "";
-        for (int i = 0; i < paddingZeros; i++)
-        {
-            padding = padding + '0';
-        }
-        // result = (padding + binaryValue.to_string()).substr(startBit, endBit - startBit);
-    }
-    // cout<<result<<endl;
-    return bitset<MAX_BITS>(result).to_ulong();
-    ;
-}
+    vector<PipelineBatch> batches;
+    SpscRing<PipelineBatch *> freeBatches;
+    SpscRing<PipelineBatch *> parsed;
+    SpscRing<PipelineBatch *> translated;
+    SpscRing<PipelineBatch *> simulated;
+};
 
-void initCache()
+void parseStage(Pipeline &pipeline, TraceReader &reader)
 {
-    dcSetsList.resize(config.dcConfig.numSets);
-    for (int i = 0; i < dcSetsList.size(); i++)
+    bool last = false;
+    while (!last)
     {
-        dcSetsList[i].setIndex = i;
-        dcSetsList[i].dcList.resize(config.dcConfig.setSize);
-        dcSetsList[i].dirty = false;
-        for (int j = 0; j < dcSetsList[i].dcList.size(); j++)
+        PipelineBatch *batch = spscPop(pipeline.freeBatches);
+        batch->count = 0;
+        while (batch->count < PIPELINE_BATCH_SIZE && nextTraceRecord(reader, batch->records[batch->count]))
         {
-            Cache entry;
-            entry.valid = false;
-            entry.count = 0;
-            entry.index = -1;
-            entry.tag = -1;
-            dcSetsList[i].dcList[j] = entry;
+            batch->count++;
         }
+        last = batch->count < PIPELINE_BATCH_SIZE;
+        batch->last = last;
+        spscPush(pipeline.parsed, batch);
     }
 }
 
-void initL2Cache()
+void translateStage(Pipeline &pipeline, Simulator &simulator)
 {
-    l2SetsList.resize(config.l2Config.numSets);
-    for (int i = 0; i < l2SetsList.size(); i++)
+    bool last = false;
+    while (!last)
     {
-        l2SetsList[i].setIndex = i;
-        l2SetsList[i].l2CacheList.resize(config.l2Config.setSize);
-        l2SetsList[i].dirty = false;
-        for (int j = 0; j < l2SetsList[i].l2CacheList.size(); j++)
+        PipelineBatch *batch = spscPop(pipeline.parsed);
+        for (size_t i = 0; i < batch->count; i++)
         {
-            Cache entry;
-            entry.valid = false;
-            entry.count = 0;
-            entry.index = -1;
-            entry.tag = -1;
-            l2SetsList[i].l2CacheList[j] = entry;
+            batch->rows[i] = TraceData();
+            batch->physicalAddresses[i] = simulator.translateAccess(batch->records[i].address, batch->records[i].core, batch->rows[i]);
         }
+        last = batch->last;
+        spscPush(pipeline.translated, batch);
     }
 }
 
-void initTlb()
+void cacheStage(Pipeline &pipeline, Simulator &simulator)
 {
-    tlbSetsList.resize(config.dtlbConfig.numSets);
-    for (int i = 0; i < tlbSetsList.size(); i++)
+    bool last = false;
+    while (!last)
     {
-        tlbSetsList[i].setIndex = i;
-        tlbSetsList[i].tlbDataList.resize(config.dtlbConfig.setSize);
-        for (int j = 0; j < tlbSetsList[i].tlbDataList.size(); j++)
+        PipelineBatch *batch = spscPop(pipeline.translated);
+        for (size_t i = 0; i < batch->count; i++)
         {
-            TLBData entry;
-            entry.valid = false;
-            entry.physicalPageNumber = -1;
-            entry.count = 0;
-            tlbSetsList[i].tlbDataList[j] = entry;
+            simulator.accessCaches(batch->physicalAddresses[i], batch->records[i].accessType, batch->rows[i]);
         }
+        last = batch->last;
+        spscPush(pipeline.simulated, batch);
     }
 }
 
-void ptinit()
+// Simulates the trace with parsing, translation, the caches and the report each on
+// their own thread (the report on the calling one). Translation never depends on the
+// caches, and every stage sees the records in trace order, so the rows and statistics
+// are the same as simulating each access in turn.
+void runPipeline(Simulator &simulator, TraceReader &reader, RowSink &sink)
 {
-    pageTableList.resize(config.ptConfig.numPhysicalPages);
-    for (int i = 0; i < config.ptConfig.numPhysicalPages; ++i)
+    Pipeline pipeline;
+    pipeline.batches.resize(PIPELINE_BATCHES);
+    initSpscRing(pipeline.freeBatches, PIPELINE_BATCHES);
+    initSpscRing(pipeline.parsed, PIPELINE_BATCHES);
+    initSpscRing(pipeline.translated, PIPELINE_BATCHES);
+    initSpscRing(pipeline.simulated, PIPELINE_BATCHES);
+    for (PipelineBatch &batch : pipeline.batches)
     {
-        Page page;
-        page.physicalPage = -1;
-        page.index = -1;
-        page.valid = false;
-        page.dirty = false;
-        page.count = 0;
-        pageTableList[i] = page;
+        batch.records.resize(PIPELINE_BATCH_SIZE);
+        batch.physicalAddresses.resize(PIPELINE_BATCH_SIZE);
+        batch.rows.resize(PIPELINE_BATCH_SIZE);
+        spscPush(pipeline.freeBatches, &batch);
     }
-}
 
-Cache writeToDC(int index, int tag)
-{
-    Cache dcEntry;
-    int lruIndex = LRU(dcSetsList[index].dcList);
-    dcEntry.tag = tag;
-    dcEntry.valid = true;
-    dcEntry.index = lruIndex;
-    dcEntry.count = 0;
-    dcSetsList[index].dcList[lruIndex] = dcEntry;
-    return dcSetsList[index].dcList[lruIndex];
-}
+    thread parser(parseStage, ref(pipeline), ref(reader));
+    thread translator(translateStage, ref(pipeline), ref(simulator));
+    thread cacheSimulator(cacheStage, ref(pipeline), ref(simulator));
 
-int findDCData(int index, int tag)
-{
-    int key = -1;
-    for (int i = 0; i < dcSetsList[index].dcList.size(); i++)
+    bool last = false;
+    while (!last)
     {
-        if (dcSetsList[index].dcList[i].tag == tag)
+        PipelineBatch *batch = spscPop(pipeline.simulated);
+        for (size_t i = 0; i < batch->count; i++)
         {
-            key = i;
-            break;
+            consumeRow(sink, batch->rows[i]);
         }
+        last = batch->last;
+        spscPush(pipeline.freeBatches, batch);
     }
-    return key;
-}
 
-Cache writeToL2(int index, int tag)
-{
-    int lruIndex = LRU(l2SetsList[index].l2CacheList);
-    Cache l2Entry;
-    l2Entry.tag = tag;
-    l2Entry.valid = true;
-    l2Entry.index = lruIndex;
-    l2Entry.count = 0;
-    l2SetsList[index].l2CacheList[lruIndex] = l2Entry;
-    return l2SetsList[index].l2CacheList[lruIndex];
+    parser.join();
+    translator.join();
+    cacheSimulator.join();
 }
 
-void updateDCTOL2(int dcSet)
+// Outcome of one access, from its row, added to the counts of its cluster.
+void countSampledRow(SampleCounts &counts, const TraceData &row, uint64_t cycles)
 {
-    for (int i = 0; i < dcSetsList[dcSet].dcList.size(); i++)
+    counts.accesses++;
+    counts.cycles += cycles;
+    if (row.tlbRes[0] != '\0')
+    {
+        counts.dtlbLookups++;
+        counts.dtlbHits += row.tlbRes[0] == 'h';
+    }
+    if (row.ptRes[0] != '\0')
     {
-        int dcTag = dcSetsList[dcSet].dcList[i].tag;
-        int l2Tag = extractBits(dcTag, 0, l2TagBits, l2TagBits);
-        int l2Index = extractBits(dcTag, l2TagBits, l2IndexBits, l2IndexBits);
-        cout << l2Tag << " :" << l2Index << endl;
-        writeToL2(l2Index, l2Tag);
+        counts.ptLookups++;
+        counts.ptHits += row.ptRes[0] == 'h';
+    }
+    counts.dcLookups++;
+    counts.dcHits += row.dcRes[0] == 'h';
+    if (row.l2Res[0] != '\0')
+    {
+        counts.l2Lookups++;
+        counts.l2Hits += row.l2Res[0] == 'h';
     }
 }
 
-void initializeMemoryHierarchy()
+// Address bits that index both the DC and L2, as a shift and a bit count. Selecting
+// accesses by their value keeps whole DC sets and whole L2 sets.
+void sharedIndexBits(const Simulator &simulator, int &shift, int &bits)
 {
-
-    // Clear the cout output file initially
-    ofstream coutFile("trace_out.txt", ios::trunc);
-    coutFile.close();
-
-    dtlbHits = 0;
-    dtlbMisses = 0;
-    ptHits = 0;
-    ptFaults = 0;
-    dcHits = 0;
-    dcMisses = 0;
-    l2Hits = 0;
-    l2Misses = 0;
-    totalReads = 0;
-    totalWrites = 0;
-    mainMemoryRefs = 0;
-    pageTableRefs = 0;
-    diskRefs = 0;
-
-    calculateBits();
-    initCache();
-    initL2Cache();
-    initTlb();
-    ptinit();
+    const AddressLayout &layout = simulator.layout;
+    int low = layout.dcIndex.shift;
+    int high = layout.dcIndex.shift + simulator.dcIndexBits;
+    if (simulator.config.useL2Cache == 1)
+    {
+        low = max(low, layout.l2Index.shift);
+        high = min(high, layout.l2Index.shift + simulator.l2IndexBits);
+    }
+    shift = low;
+    bits = max(high - low, 0);
 }
 
-Cache performL2CacheAccess(int physicalAddess, int pageOffset, char accessType)
+// Set sampling: every access is translated, so the TLB and page table stay exact, but
+// only accesses to 1 in every setRatio DC sets (and the L2 sets they map to) reach the
+// caches. The page walk reads of every access still do, since a walk for an unsampled
+// access may read an entry in a sampled set. Each sampled DC set is one cluster.
+void runSetSampling(Simulator &simulator, TraceReader &reader, int setRatio, SampleEstimates &estimates, uint64_t &totalAccesses)
 {
-    Cache l2Cache;
-    int index = extractBits(physicalAddess, l2TagBits, l2TagBits + l2IndexBits, l2TotalBits);
-    int tag = extractBits(physicalAddess, 0, l2TagBits, l2TotalBits);
-    // cout<<" l2tag: "<< hex << tag <<" | ";
-    // cout<<" l2Index: "<<index<<" | ";
+    int shift, bits;
+    sharedIndexBits(simulator, shift, bits);
+    uint64_t mask = static_cast<uint64_t>(setRatio - 1);
+    vector<SampleCounts> clusters(simulator.config.dcConfig.numSets);
 
-    traceDataList[trace].l2Index = index;
-    traceDataList[trace].l2Tag = tag;
-    bool flag = false;
-    for (int i = 0; i < l2SetsList[index].l2CacheList.size(); i++)
+    TraceRecord record;
+    TraceData row;
+    while (nextTraceRecord(reader, record))
     {
-        if (l2SetsList[index].l2CacheList[i].tag == tag)
+        totalAccesses++;
+        uint64_t cyclesBefore = simulator.totalCycles();
+        row = TraceData();
+        uint64_t physicalAddress = simulator.translateAccess(record.address, record.core, row);
+        if (((physicalAddress >> shift) & mask) != 0)
         {
-            strcpy(traceDataList[trace].l2Res, "hit ");
-            l2Hits++;
-            l2SetsList[index].l2CacheList[i].count++;
-            l2Cache = l2SetsList[index].l2CacheList[i];
-            flag = true;
+            simulator.replayPageWalk(row);
+            continue;
         }
+        simulator.accessCaches(physicalAddress, record.accessType, row);
+        countSampledRow(clusters[row.dcIndex], row, simulator.totalCycles() - cyclesBefore);
     }
-    if (flag == false)
+    for (size_t set = 0; set < clusters.size(); set++)
     {
-        strcpy(traceDataList[trace].l2Res, "miss");
-        l2Misses++;
-        l2Cache = writeToL2(index, tag);
-        mainMemoryRefs++;
+        if (((static_cast<uint64_t>(set) << simulator.layout.dcIndex.shift >> shift) & mask) == 0)
+        {
+            addSampleCluster(estimates, clusters[set]);
+        }
     }
-    return l2Cache;
 }
 
-void performDataCacheAccess(int physicalAddess, int pageOffSet, char accessType)
+// Interval sampling: the last unitSize accesses of every period are measured. With
+// warmup < 0 every other access is simulated too, keeping all state warm (functional
+// warming); otherwise only the warmup accesses before each unit are, and the rest are
+// skipped. Each unit is one cluster.
+void runIntervalSampling(Simulator &simulator, TraceReader &reader, uint64_t unitSize, uint64_t period, int64_t warmup,
+                         SampleEstimates &estimates, uint64_t &totalAccesses)
 {
-    Cache dcCache;
-    int index = extractBits(physicalAddess, dcTagBits, dcTagBits + dcIndexBits, dcTotalBits);
-    int tag = extractBits(physicalAddess, 0, dcTagBits, dcTotalBits);
-    // cout<<" dctag: "<< hex << extractBits(physicalAddess,0,dcTagBits,dcTotalBits)<<" | ";
-    // cout<<" dcIndex: "<<index<<" | ";
-
-    traceDataList[trace].dcIndex = index;
-    traceDataList[trace].dcTag = tag;
-    int key = findDCData(index, tag);
-    bool writeToL2 = false;
-    bool writeTodc = false;
-    if (key != -1)
+    uint64_t unitStart = period - unitSize;
+    uint64_t warmStart = warmup < 0 || static_cast<uint64_t>(warmup) >= unitStart ? 0 : unitStart - warmup;
+    SimulationStats before;
+    TraceRecord record;
+    while (nextTraceRecord(reader, record))
     {
-        strcpy(traceDataList[trace].dcRes, "hit");
-        dcHits++;
-        dcSetsList[index].dcList[key].count++;
-    }
-    else
-    {
-        strcpy(traceDataList[trace].dcRes, "miss");
-        dcMisses++;
+        uint64_t phase = totalAccesses % period;
+        totalAccesses++;
+        if (phase < warmStart)
+        {
+            continue;
+        }
+        if (phase == unitStart)
+        {
+            before = simulator.stats();
+        }
+        simulator.simulateMemoryAccess(record.address, record.accessType, record.core);
+        if (phase == period - 1)
+        {
+            SimulationStats after = simulator.stats();
+            SampleCounts counts;
+            counts.accesses = (after.totalReads + after.totalWrites) - (before.totalReads + before.totalWrites);
+            counts.dtlbHits = after.dtlbHits - before.dtlbHits;
+            counts.dtlbLookups = (after.dtlbHits + after.dtlbMisses) - (before.dtlbHits + before.dtlbMisses);
+            counts.ptHits = after.ptHits - before.ptHits;
+            counts.ptLookups = (after.ptHits + after.ptFaults) - (before.ptHits + before.ptFaults);
+            counts.dcHits = after.dcHits - before.dcHits;
+            counts.dcLookups = (after.dcHits + after.dcMisses) - (before.dcHits + before.dcMisses);
+            counts.l2Hits = after.l2Hits - before.l2Hits;
+            counts.l2Lookups = (after.l2Hits + after.l2Misses) - (before.l2Hits + before.l2Misses);
+            counts.cycles = static_cast<double>(after.totalCycles - before.totalCycles);
+            addSampleCluster(estimates, counts);
+        }
     }
-    if (config.dcConfig.writeThroughOrNoWriteAllocate == 1)
-    {
-        // Write
-        if (accessType == 'W')
+}
+
+void printUsage(const char *program)
+{
+    cerr << "Usage: " << program << " [--stats-only] [--mrc] [--pipeline]" << endl;
+    cerr << "       " << program << " --sample-sets N | --sample-intervals U:P[:W]" << endl;
+    cerr << "       " << program << " --sweep <config> <config>... [--threads N]" << endl;
+    cerr << "       " << program << " [--restore <file> [--reset-stats]] [--save-checkpoint N <file>]" << endl;
+    cerr << "       " << program << " --intervals N <file>" << endl;
+    cerr << "       " << program << " --results json|csv [--results-file <file>] [--results-rows <file>]" << endl;
+    cerr << "  --stats-only  print the configuration and final statistics without per-access rows" << endl;
+    cerr << "  --mrc         also print DC and L2 miss ratio curves from one stack-distance pass" << endl;
+    cerr << "  --pipeline    run parsing, translation, the caches and the report on separate threads" << endl;
+    cerr << "  --sample-sets      simulate the caches for 1 in N sets and estimate the statistics" << endl;
+    cerr << "  --sample-intervals measure U accesses in every P, warming the caches with the W before" << endl;
+    cerr << "                     each (default: all the others) and estimate the statistics" << endl;
+    cerr << "  --sweep       simulate every listed configuration in one pass over trace.dat" << endl;
+    cerr << "  --threads     worker threads for --sweep (default: one per core)" << endl;
+    cerr << "  --save-checkpoint  stop after access N and save the simulator state to <file>" << endl;
+    cerr << "  --restore          resume from a checkpoint, skipping the accesses it has simulated" << endl;
+    cerr << "  --reset-stats      start the statistics from zero after --restore, keeping the warm state" << endl;
+    cerr << "  --intervals        write the change of every counter over each N accesses to <file>," << endl;
+    cerr << "                     as JSON lines for a .json or .jsonl file and CSV otherwise" << endl;
+    cerr << "  --results          write the configuration, bit widths and statistics as JSON or CSV to" << endl;
+    cerr << "                     stdout or --results-file (- for stdout) instead of the text report" << endl;
+    cerr << "  --results-rows     also write every access to <file> (- for stdout) in the same format" << endl;
+}
+
+// Loads a checkpoint into simulator and sets traceOffset to the trace records it covers.
+bool restoreCheckpoint(Simulator &simulator, const string &filename, bool resetStats, uint64_t &traceOffset)
+{
+    uint64_t offset;
+    if (!simulator.loadCheckpoint(filename, offset))
+    {
+        return false;
+    }
+    traceOffset = offset;
+    if (resetStats)
+    {
+        simulator.resetStatistics();
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef MEMHIER_PROFILE
+    ProfileSummary profileSummary(cerr);
+#endif
+    bool statsOnly = false;
+    bool missRatioCurves = false;
+    bool pipelined = false;
+    vector<string> sweepConfigs;
+    int threadCount = 0;
+    int sampleSets = 0;
+    uint64_t sampleUnit = 0;
+    uint64_t samplePeriod = 0;
+    int64_t sampleWarmup = -1;
+    uint64_t checkpointAccess = 0;
+    string checkpointFile;
+    string restoreFile;
+    bool resetStats = false;
+    uint64_t intervalLength = 0;
+    string intervalFile;
+    bool structuredResults = false;
+    ResultsFormat resultsFormat = RESULTS_JSON;
+    string resultsFile;
+    string resultsRowsFile;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stats-only") == 0)
         {
-            if (key != -1) // Hit
-            {
-                dcCache = dcSetsList[index].dcList[key];
-                writeToL2 = true;
-            }
-            else
-            {
-                writeToL2 = true;
-            }
+            statsOnly = true;
         }
-        // Read
-        else
+        else if (strcmp(argv[i], "--mrc") == 0)
         {
-            if (key != -1)
+            missRatioCurves = true;
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0)
+        {
+            pipelined = true;
+        }
+        else if (strcmp(argv[i], "--sweep") == 0)
+        {
+            while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
             {
-                dcCache = dcSetsList[index].dcList[key];
+                sweepConfigs.push_back(argv[++i]);
             }
-            else
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sample-sets") == 0 && i + 1 < argc)
+        {
+            sampleSets = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sample-intervals") == 0 && i + 1 < argc)
+        {
+            unsigned long long unit = 0, period = 0;
+            long long warmup = -1;
+            if (sscanf(argv[++i], "%llu:%llu:%lld", &unit, &period, &warmup) < 2 || unit == 0 || period < unit)
             {
-                writeToL2 = true;
-                writeTodc = true;
+                cerr << "Error: --sample-intervals takes U:P[:W] with 0 < U <= P." << endl;
+                return 1;
             }
+            sampleUnit = unit;
+            samplePeriod = period;
+            sampleWarmup = warmup;
         }
-    }
-    else
-    {
-        if (accessType == 'W')
+        else if (strcmp(argv[i], "--save-checkpoint") == 0 && i + 2 < argc)
+        {
+            checkpointAccess = strtoull(argv[++i], nullptr, 10);
+            checkpointFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc)
+        {
+            restoreFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--reset-stats") == 0)
+        {
+            resetStats = true;
+        }
+        else if (strcmp(argv[i], "--results") == 0 && i + 1 < argc)
         {
-            if (key != -1) // Hit
+            if (!parseResultsFormat(argv[++i], resultsFormat))
             {
-                dcCache = dcSetsList[index].dcList[key];
+                cerr << "Error: --results takes json or csv." << endl;
+                return 1;
             }
-            else
+            structuredResults = true;
+        }
+        else if (strcmp(argv[i], "--results-file") == 0 && i + 1 < argc)
+        {
+            resultsFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--results-rows") == 0 && i + 1 < argc)
+        {
+            resultsRowsFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--intervals") == 0 && i + 2 < argc)
+        {
+            intervalLength = strtoull(argv[++i], nullptr, 10);
+            intervalFile = argv[++i];
+            if (intervalLength == 0)
             {
-                if (dcSetsList[index].dirty)
-                {
-                    // update set
-                    updateDCTOL2(index);
-                    dcSetsList[index].dirty = false;
-                }
-                writeTodc = true;
+                cerr << "Error: --intervals needs a positive number of accesses." << endl;
+                return 1;
             }
         }
         else
         {
-            if (key != -1)
-            {
-                dcCache = dcSetsList[index].dcList[key];
-            }
-            else
-            {
-                if (dcSetsList[index].dirty)
-                {
-                    // update set
-                    updateDCTOL2(index);
-                    dcSetsList[index].dirty = false;
-                }
-                writeTodc = true;
-            }
+            printUsage(argv[0]);
+            return 1;
         }
     }
-    if (writeToL2 && config.useL2Cache == 1)
+
+    if (missRatioCurves && !sweepConfigs.empty())
     {
-        Cache l2Cache = performL2CacheAccess(physicalAddess, pageOffSet, accessType);
+        cerr << "Error: --mrc does not work with --sweep." << endl;
+        return 1;
     }
-    if (writeTodc == true)
+    if (pipelined && !sweepConfigs.empty())
     {
-        dcCache = writeToDC(index, tag);
+        cerr << "Error: --pipeline does not work with --sweep." << endl;
+        return 1;
     }
-}
-
-Page performPageTableLookup(int virtualPageNumber)
-{
-    pageTableRefs++;
-    for (int i = 0; i < pageTableList.size(); i++)
+    if ((sampleSets > 0 || samplePeriod > 0) && !sweepConfigs.empty())
     {
-        if (pageTableList[i].virtualPage == virtualPageNumber)
-        {
-            strcpy(traceDataList[trace].ptRes, "hit");
-            ptHits++;
-            pageTableList[i].count++;
-            return pageTableList[i];
-        }
+        cerr << "Error: The sampling modes do not work with --sweep." << endl;
+        return 1;
     }
-    if (currenPhysicalPageAddress < config.ptConfig.numPhysicalPages - 1)
+    if (!checkpointFile.empty() && (pipelined || !sweepConfigs.empty() || sampleSets > 0 || samplePeriod > 0))
     {
-        currenPhysicalPageAddress++;
+        cerr << "Error: --save-checkpoint only works with the sequential simulation." << endl;
+        return 1;
     }
-    else
+    if (!intervalFile.empty() && (pipelined || !sweepConfigs.empty() || sampleSets > 0 || samplePeriod > 0))
     {
-        currenPhysicalPageAddress = LRU(pageTableList);
+        cerr << "Error: --intervals only works with the sequential simulation." << endl;
+        return 1;
     }
-    strcpy(traceDataList[trace].ptRes, "miss");
-    ptFaults++;
-    diskRefs++;
-    Page pageData;
-    pageData.physicalPage = currenPhysicalPageAddress;
-    pageData.index = currenPhysicalPageAddress;
-    pageData.virtualPage = virtualPageNumber;
-    pageData.count = 0;
-    pageTableList[currenPhysicalPageAddress] = pageData;
-
-    return pageData;
-}
-
-TLBData performTLBLookup(int virtualAddress)
-{
-    TLBData tLBData;
-    int virtualPageNumber = extractBits(virtualAddress, 0, VPNBits, totalBits);
-    int index = extractBits(virtualAddress, tagBits, tagBits + indexBits, totalBits);
-    int tag = extractBits(virtualAddress, 0, tagBits, totalBits);
-
-    traceDataList[trace].tlbIndex = index;
-    traceDataList[trace].tlbTag = tag;
-    bool flag = false;
-    for (int i = 0; i < tlbSetsList[index].tlbDataList.size(); i++)
+    if (!structuredResults && (!resultsFile.empty() || !resultsRowsFile.empty()))
+    {
+        cerr << "Error: --results-file and --results-rows need --results." << endl;
+        return 1;
+    }
+    if (structuredResults && (missRatioCurves || sampleSets > 0 || samplePeriod > 0))
+    {
+        cerr << "Error: --results does not cover --mrc or the sampling modes." << endl;
+        return 1;
+    }
+    if (!resultsRowsFile.empty() && !sweepConfigs.empty())
     {
-        if (tlbSetsList[index].tlbDataList[i].tag == tag)
+        cerr << "Error: --results-rows does not work with --sweep." << endl;
+        return 1;
+    }
+    if (resultsRowsFile == "-" && (resultsFile.empty() || resultsFile == "-"))
+    {
+        cerr << "Error: --results-rows - needs --results-file to keep the results off stdout." << endl;
+        return 1;
+    }
+    FILE *resultsOutput = nullptr;
+    if (structuredResults)
+    {
+        resultsOutput = resultsFile.empty() || resultsFile == "-" ? stdout : fopen(resultsFile.c_str(), "w");
+        if (resultsOutput == nullptr)
         {
-            dtlbHits++;
-            strcpy(traceDataList[trace].tlbRes, "hit");
-            tlbSetsList[index].tlbDataList[i].count++;
-            tLBData = tlbSetsList[index].tlbDataList[i];
-            flag = true;
+            cerr << "Error: Unable to open results file " << resultsFile << "." << endl;
+            return 1;
         }
     }
-    if (flag == false)
+    if (resetStats && restoreFile.empty())
     {
-        dtlbMisses++;
-        strcpy(traceDataList[trace].tlbRes, "miss");
-        Page pageData = performPageTableLookup(virtualPageNumber);
-        int lruIndex = LRU(tlbSetsList[index].tlbDataList);
-        TLBData tlbEntry;
-        tlbEntry.tag = tag;
-        tlbEntry.index = lruIndex;
-        tlbEntry.physicalPageNumber = pageData.physicalPage;
-        tlbEntry.valid = false;
-        tlbEntry.count = 0;
-        tlbSetsList[index].tlbDataList[lruIndex] = tlbEntry;
-
-        tLBData = tlbEntry;
+        cerr << "Error: --reset-stats needs --restore." << endl;
+        return 1;
     }
 
-    return tLBData;
-}
+    // printConfiguration();
 
-void simulateMemoryAccess(string address, char accessType)
-{
-    int virtualAddress = stoi(address, nullptr, 16);
-    int pageOffSet = extractBits(virtualAddress, tagBits + indexBits, tagBits + indexBits + pageOffSetBits, totalBits);
-    traceDataList[trace].virtualAddress = virtualAddress;
-    traceDataList[trace].pageOffset = pageOffSet;
-    int virtualPageNumber = extractBits(virtualAddress, 0, VPNBits, totalBits);
-    traceDataList[trace].virtualPage = virtualPageNumber;
+    // Stream the trace file
+    TraceReader reader;
+    openTraceFile(reader, "./trace.dat");
 
-    // Simulate TLB lookup
-    int pageNum;
-    if (config.useTLB == 1)
+    // The report goes to trace_out.txt and stdout as it is produced. Structured results
+    // replace it, so it then has nowhere to go.
+    ReportWriter report;
+    openReport(report);
+    if (!structuredResults)
     {
-        TLBData tlbEntry = performTLBLookup(virtualAddress);
-        traceDataList[trace].physicalPage = tlbEntry.physicalPageNumber;
-        pageNum = tlbEntry.physicalPageNumber;
+        FILE *outputFile = fopen("trace_out.txt", "w");
+        if (outputFile != nullptr)
+        {
+            report.files.push_back(outputFile);
+        }
+        report.files.push_back(stdout);
     }
-    else
+
+    if (!sweepConfigs.empty())
     {
-        Page page = performPageTableLookup(virtualAddress);
-        traceDataList[trace].physicalPage = page.physicalPage;
-        pageNum = page.physicalPage;
-        ;
-    }
-    // printDTLB();
-    // printPageTable();
+        vector<Simulator> simulators;
+        simulators.reserve(sweepConfigs.size());
+        for (const string &configFile : sweepConfigs)
+        {
+            simulators.emplace_back(readConfigFile(configFile));
+        }
+        // Every configuration resumes from the same checkpoint
+        uint64_t traceOffset = 0;
+        for (Simulator &simulator : simulators)
+        {
+            if (!restoreFile.empty() && !restoreCheckpoint(simulator, restoreFile, resetStats, traceOffset))
+            {
+                closeTraceFile(reader);
+                closeReport(report);
+                return 1;
+            }
+        }
+        if (skipTraceRecords(reader, traceOffset) < traceOffset)
+        {
+            cerr << "Error: The trace is shorter than checkpoint " << restoreFile << "." << endl;
+            closeTraceFile(reader);
+            closeReport(report);
+            return 1;
+        }
+        if (threadCount <= 0)
+        {
+            threadCount = max(1u, thread::hardware_concurrency());
+        }
+        threadCount = min(threadCount, static_cast<int>(simulators.size()));
+        runSweep(simulators, reader, threadCount);
+        closeTraceFile(reader);
+
+        if (structuredResults)
+        {
+            vector<const Simulator *> runs;
+            for (const Simulator &simulator : simulators)
+            {
+                runs.push_back(&simulator);
+            }
+            writeResults(resultsOutput, resultsFormat, runs, sweepConfigs);
+            if (resultsOutput != stdout)
+                fclose(resultsOutput);
+            closeReport(report);
+            return 0;
+        }
 
-    // DC LookUP
-    string pageValue = convertHex(pageNum, config.ptConfig.numPhysicalPages / 4);
-    string pageOffsetValue = convertHex(pageOffSet, pageOffSetBits / 4);
-    int physicalAddress = concatAsHex(pageValue, pageOffsetValue);
-    // cout<<pageValue<<" : "<<pageOffsetValue<<" : "<<physicalAddress;
-    performDataCacheAccess(physicalAddress, pageOffSet, accessType);
-    // printDC();
+        ostringstream statisticsText;
+        printSweepStatistics(statisticsText, sweepConfigs, simulators);
+        reportWrite(report, statisticsText.str());
+        closeReport(report);
+        return 0;
+    }
 
-    if (accessType == 'R')
+    Simulator simulator(readConfigFile("./trace.config"));
+    if (sampleSets > 0)
     {
-        totalReads++;
+        int shift, bits;
+        sharedIndexBits(simulator, shift, bits);
+        if ((sampleSets & (sampleSets - 1)) != 0 || sampleSets > (1 << bits))
+        {
+            cerr << "Error: --sample-sets needs a power of two up to " << (1 << bits) << " for this configuration." << endl;
+            closeTraceFile(reader);
+            closeReport(report);
+            return 1;
+        }
     }
-    else if (accessType == 'W')
+    // Records already simulated, by the checkpoint restored or by this run
+    uint64_t traceOffset = 0;
+    if (!restoreFile.empty())
     {
-        totalWrites++;
+        if (!restoreCheckpoint(simulator, restoreFile, resetStats, traceOffset))
+        {
+            closeTraceFile(reader);
+            closeReport(report);
+            return 1;
+        }
+        if (skipTraceRecords(reader, traceOffset) < traceOffset)
+        {
+            cerr << "Error: The trace is shorter than checkpoint " << restoreFile << "." << endl;
+            closeTraceFile(reader);
+            closeReport(report);
+            return 1;
+        }
     }
 
-    // Update cache hit ratios
-    dtlbHitRatio = (dtlbHits * 1.0) / (dtlbHits + dtlbMisses);
-    ptHitRatio = (ptHits * 1.0) / (ptHits + ptFaults);
-    dcHitRatio = (dcHits * 1.0) / (dcHits + dcMisses);
-    l2HitRatio = (l2Hits * 1.0) / (l2Hits + l2Misses);
-}
-
-void printFile()
-{
-    FILE *readFile = fopen("trace_out.txt", "r");
+    ostringstream configText;
+    simulator.printConfig(configText);
+    reportWrite(report, configText.str());
 
-    if (readFile != nullptr)
+    if (sampleSets > 0 || samplePeriod > 0)
     {
-
-        // Print every line of the file
-        cout << "File content:" << endl;
-        char line[256]; // Adjust the buffer size as needed
-        while (fgets(line, sizeof(line), readFile))
+        SampleEstimates estimates;
+        uint64_t totalAccesses = 0;
+        ostringstream method;
+        double sampledFraction;
+        if (sampleSets > 0)
         {
-            printf("%s", line);
+            runSetSampling(simulator, reader, sampleSets, estimates, totalAccesses);
+            method << "1 in " << sampleSets << " sets";
+            sampledFraction = 1.0 / sampleSets;
+        }
+        else
+        {
+            runIntervalSampling(simulator, reader, sampleUnit, samplePeriod, sampleWarmup, estimates, totalAccesses);
+            method << sampleUnit << " of every " << samplePeriod << " accesses, ";
+            if (sampleWarmup < 0)
+                method << "functional warming";
+            else
+                method << sampleWarmup << " accesses of warm-up";
+            sampledFraction = totalAccesses > 0 ? static_cast<double>(estimates.measuredAccesses) / totalAccesses : 0;
         }
+        closeTraceFile(reader);
 
-        // Close the file
-        fclose(readFile);
+        ostringstream statisticsText;
+        printSampledStatistics(statisticsText, method.str(), estimates, totalAccesses, sampledFraction);
+        reportWrite(report, statisticsText.str());
+        closeReport(report);
+        return 0;
     }
-}
-int main()
-{
-    config = readConfigFile("./trace.config");
 
-    // printConfiguration();
-
-    // Read trace file
-    vector<string> traceData = readTraceFile("./trace.dat");
-    // Iterate over each trace entry and simulate memory access
-    initializeMemoryHierarchy();
+    if (!statsOnly)
+    {
+        printHeader(report);
+    }
 
-    ofstream outputFile("trace_out.txt", ios::app);
-    streambuf *coutbuf = cout.rdbuf(); // Save old buf
-    cout.rdbuf(outputFile.rdbuf());
-    printConfig();
-    for (const string &traceEntry : traceData)
+    RowSink sink;
+    if (!statsOnly && !structuredResults)
+    {
+        sink.report = &report;
+    }
+    ResultRowsWriter resultRows;
+    if (!resultsRowsFile.empty())
     {
-        char accessType = traceEntry[0];
-        string hexAddress = traceEntry.substr(2); // Assuming hex address starts at index 2
-        traceDataList.push_back(initTrace());
-        simulateMemoryAccess(hexAddress, accessType);
-        trace++;
+        if (!openResultRows(resultRows, resultsRowsFile, resultsFormat))
+        {
+            closeTraceFile(reader);
+            closeReport(report);
+            return 1;
+        }
+        sink.rows = &resultRows;
+    }
+    // The DC profile sees every access, the L2 profile the accesses the DC passes on
+    StackDistanceProfile dcProfile;
+    StackDistanceProfile l2Profile;
+    if (missRatioCurves)
+    {
+        initStackDistanceProfile(dcProfile, simulator.config.dcConfig.lineSize, max(MRC_MAX_SETS, simulator.config.dcConfig.numSets));
+        initStackDistanceProfile(l2Profile, simulator.config.l2Config.lineSize, max(MRC_MAX_SETS, simulator.config.l2Config.numSets));
+        sink.dcProfile = &dcProfile;
+        sink.l2Profile = &l2Profile;
+        sink.dcIndexBits = simulator.dcIndexBits;
+        sink.l2IndexBits = simulator.l2IndexBits;
     }
 
-    FILE *printfFile = fopen("trace_out.txt", "a");
-    printHeader(printfFile);
-    printTraceData(printfFile);
-    fclose(printfFile);
+    if (pipelined)
+    {
+        runPipeline(simulator, reader, sink);
+    }
+    else
+    {
+        IntervalWriter intervals;
+        if (!intervalFile.empty() && !openIntervalWriter(intervals, intervalFile, intervalLength, traceOffset, simulator.stats()))
+        {
+            closeTraceFile(reader);
+            closeReport(report);
+            return 1;
+        }
+        // Iterate over each trace entry and simulate memory access
+        TraceRecord record;
+        while ((checkpointFile.empty() || traceOffset < checkpointAccess) && nextTraceRecord(reader, record))
+        {
+            simulator.simulateMemoryAccess(record.address, record.accessType, record.core);
+            consumeRow(sink, simulator.traceData);
+            traceOffset++;
+            intervalTick(intervals, simulator, traceOffset);
+        }
+        closeIntervalWriter(intervals, simulator, traceOffset);
+        if (!checkpointFile.empty())
+        {
+            if (traceOffset < checkpointAccess)
+            {
+                cerr << "Error: The trace ends after " << traceOffset << " accesses, before checkpoint access "
+                     << checkpointAccess << "." << endl;
+                closeTraceFile(reader);
+                closeReport(report);
+                return 1;
+            }
+            if (!simulator.saveCheckpoint(checkpointFile, traceOffset))
+            {
+                closeTraceFile(reader);
+                closeReport(report);
+                return 1;
+            }
+        }
+    }
+    closeTraceFile(reader);
+    closeResultRows(resultRows);
 
-    printSimulationStatistics();
-    outputFile.close();
+    if (structuredResults)
+    {
+        writeResults(resultsOutput, resultsFormat, {&simulator}, {"./trace.config"});
+        if (resultsOutput != stdout)
+            fclose(resultsOutput);
+        closeReport(report);
+        return 0;
+    }
 
-    printFile();
+    ostringstream statisticsText;
+    simulator.printSimulationStatistics(statisticsText);
+    if (missRatioCurves)
+    {
+        printMissRatioCurve(statisticsText, "DC", dcProfile, simulator.config.dcConfig.numSets, simulator.config.dcConfig.setSize);
+        if (simulator.config.useL2Cache == 1)
+        {
+            printMissRatioCurve(statisticsText, "L2", l2Profile, simulator.config.l2Config.numSets, simulator.config.l2Config.setSize);
+        }
+    }
+    reportWrite(report, statisticsText.str());
+    closeReport(report);
     return 0;
 }
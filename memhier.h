@@ -0,0 +1,843 @@
+#ifndef MEMHIER_H
+#define MEMHIER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// The simulator library: configuration, the set-associative structures and the
+// Simulator class. A Simulator owns all of its state, so any number of them can run in
+// one process, on one thread each. main (memhier.cpp) is one client; others link
+// simulator.cpp and include this header.
+
+const int POSITIVE_INFINITY = std::numeric_limits<int>::max();
+const size_t CACHE_LINE_SIZE = 64;
+const int MAX_BITS = 64;
+const int SRRIP_MAX_RRPV = 3;
+const int ACCESS_BYTES = 4; // traces carry no access size, so a store moves one word
+const int PREFETCH_STRIDE_ENTRIES = 64; // stride table entries, indexed by page
+const int PREFETCH_STREAMS = 8;         // streams tracked at once
+const int PREFETCH_STREAM_WINDOW = 4;   // lines a miss may be from a stream's last line to extend it
+const int MAX_PAGE_TABLE_LEVELS = 5;    // x86-64 five-level paging
+const int PTE_BYTES = 8;                // bytes per page table entry
+const int HUGE_PAGE_SIZES = 2;          // leaves one and two levels above the last, 2M and 1G on x86-64
+
+enum ReplacementPolicy
+{
+    POLICY_LFU, // original behavior: evict the entry with the fewest hits since it was filled
+    POLICY_LRU,
+    POLICY_PLRU,
+    POLICY_FIFO,
+    POLICY_RANDOM,
+    POLICY_SRRIP
+};
+
+enum PrefetcherType
+{
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE, // the lines after a miss
+    PREFETCH_STRIDE,    // a repeating stride between accesses to the same page
+    PREFETCH_STREAM     // runs of misses to neighbouring lines, in either direction
+};
+
+struct DataTLBConfig
+{
+    int numSets;
+    int setSize;
+    ReplacementPolicy policy = POLICY_LFU;
+};
+
+struct DataCacheConfig
+{
+    int numSets;
+    int setSize;
+    int lineSize;
+    bool writeThroughOrNoWriteAllocate;
+    ReplacementPolicy policy = POLICY_LFU;
+    PrefetcherType prefetcher = PREFETCH_NONE;
+    int prefetchDegree = 1; // lines fetched per prefetch trigger
+};
+
+struct L2CacheConfig
+{
+    int numSets;
+    int setSize;
+    int lineSize;
+    ReplacementPolicy policy = POLICY_LFU;
+    PrefetcherType prefetcher = PREFETCH_NONE;
+    int prefetchDegree = 1;
+};
+
+// Huge pages of one size. They come from a pool of frames apart from the base pages, as
+// reserved for hugetlbfs, and their translations may have a TLB array of their own in each core.
+struct HugePageConfig
+{
+    int numPages = 0;   // frames in the pool, 0 for no huge pages of this size
+    int tlbSets = 0;    // 0 caches the translations in the base page TLB, one base page at a time
+    int tlbSetSize = 0;
+};
+
+// Virtual addresses [start, end) are mapped with huge pages of pageSize, the levels
+// above the last level of the page table their entries are leaves in.
+struct HugePageRegion
+{
+    uint64_t start;
+    uint64_t end;
+    int pageSize;
+};
+
+// levels = 0 keeps the original flat page table, whose walks cost a fixed latency.
+// Otherwise the page table is a radix tree of that many levels, each indexed by
+// log2(pageSize / PTE_BYTES) bits of the virtual page number as on x86-64 (4 levels
+// and 4 KiB pages give 48 bit virtual addresses, 5 levels 57 bits), and every walk
+// reads its entries through the DC and L2.
+struct MemoryConfig
+{
+    int numVirtualPages;
+    int numPhysicalPages;
+    int pageSize;
+    ReplacementPolicy policy = POLICY_LFU;
+    int levels = 0;
+    int walkCacheEntries = 0; // per core and upper level, 0 for no page walk caches
+    HugePageConfig hugePages[HUGE_PAGE_SIZES]; // one level up first; need a radix page table
+    std::vector<HugePageRegion> hugePageRegions;
+};
+
+// Cycles charged each time an access reaches a level. The defaults apply when
+// trace.config has no Timing configuration section.
+struct TimingConfig
+{
+    int tlbLatency = 1;
+    int pageWalkLatency = 50;
+    int dcLatency = 4;
+    int l2Latency = 12;
+    int memoryLatency = 100;
+    int diskLatency = 100000;
+};
+
+struct Configuration
+{
+    DataTLBConfig dtlbConfig;
+    MemoryConfig ptConfig;
+    DataCacheConfig dcConfig;
+    L2CacheConfig l2Config;
+    TimingConfig timing;
+    bool useVirtualAddresses;
+    bool useTLB;
+    bool useL2Cache;
+    int numCores = 1; // each core has its own TLB and DC; the page table and L2 are shared
+};
+
+struct Page
+{
+    bool dirty = false;
+    int physicalPage = -1;
+    int index = -1;
+    int64_t virtualPage = -1;
+    int valid = false;
+};
+
+struct TraceData
+{
+    int core = 0;
+    int64_t virtualAddress = -1;
+    int64_t virtualPage = -1;
+    int pageOffset = -1;
+    int64_t tlbTag = -1;
+    int tlbIndex = -1;
+    const char *tlbRes = "";
+    const char *ptRes = "";
+    int physicalPage = -1;
+    int dcTag = -1;
+    int dcIndex = -1;
+    const char *dcRes = "";
+    int l2Tag = -1;
+    int l2Index = -1;
+    const char *l2Res = "";
+    // Page table entries the access's walk reads, left by translateAccess for
+    // accessCaches to fetch through the caches
+    int walkReads = 0;
+    uint64_t walkAddresses[MAX_PAGE_TABLE_LEVELS];
+};
+
+// How one level of the hierarchy handled an access.
+enum LevelResult
+{
+    LEVEL_NOT_ACCESSED, // disabled, or the access was resolved before reaching it
+    LEVEL_HIT,
+    LEVEL_MISS
+};
+
+// Per-level outcome of one access made through Simulator::access.
+struct AccessResult
+{
+    LevelResult tlb = LEVEL_NOT_ACCESSED;
+    LevelResult pageTable = LEVEL_NOT_ACCESSED;
+    LevelResult dataCache = LEVEL_NOT_ACCESSED;
+    LevelResult l2Cache = LEVEL_NOT_ACCESSED;
+    int64_t physicalAddress = -1;
+    int cycles = 0;
+};
+
+struct MemoryAccess
+{
+    uint64_t address;
+    bool isWrite;
+    int core; // issuing core, wrapped modulo the configured number of cores
+};
+
+// Prefetches into one cache level. Accuracy is the fraction of prefetched lines used
+// before they left the cache, coverage the fraction of would-be demand misses they
+// removed, and timeliness the fraction of used prefetches that had arrived in time.
+struct PrefetchStats
+{
+    uint64_t issued = 0;
+    uint64_t useful = 0;          // prefetched lines hit by a demand access
+    uint64_t late = 0;            // useful prefetches hit before their fetch had completed
+    uint64_t unused = 0;          // prefetched lines evicted or invalidated before any use
+    uint64_t pollutionMisses = 0; // demand misses on lines a prefetch had evicted
+    double accuracy = 0;
+    double coverage = 0;
+    double timeliness = 0;
+};
+
+// Snapshot of a simulator's counters. Ratios of levels that saw no accesses are 0.
+struct SimulationStats
+{
+    uint64_t dtlbHits = 0;
+    uint64_t dtlbMisses = 0;
+    uint64_t ptHits = 0;
+    uint64_t ptFaults = 0;
+    uint64_t dcHits = 0;
+    uint64_t dcMisses = 0;
+    uint64_t l2Hits = 0;
+    uint64_t l2Misses = 0;
+    uint64_t totalReads = 0;
+    uint64_t totalWrites = 0;
+    uint64_t mainMemoryRefs = 0;
+    uint64_t pageTableRefs = 0;
+    uint64_t diskRefs = 0;
+    uint64_t dcWriteBacks = 0;
+    uint64_t l2WriteBacks = 0;
+    uint64_t coherenceMisses = 0; // totals over all cores, see CoreState
+    uint64_t invalidations = 0;
+    uint64_t upgrades = 0;
+    uint64_t falseSharing = 0;
+    uint64_t coherenceWriteBacks = 0;
+    uint64_t pageWalks = 0;     // walks of the radix page table
+    uint64_t walkCacheHits = 0; // walks a page walk cache let start below the root
+    uint64_t pteReads = 0;      // page table entries the walks read through the caches
+    uint64_t pteDCHits = 0;
+    uint64_t pteL2Hits = 0;
+    uint64_t pteMemoryRefs = 0;
+    uint64_t dtlbSizeHits[HUGE_PAGE_SIZES + 1] = {}; // per page size, base pages first
+    uint64_t dtlbSizeMisses[HUGE_PAGE_SIZES + 1] = {};
+    uint64_t pageSizeFaults[HUGE_PAGE_SIZES + 1] = {};
+    uint64_t tlbReach = 0; // bytes the TLB arrays of one core map when full
+    double dtlbHitRatio = 0;
+    double ptHitRatio = 0;
+    double dcHitRatio = 0;
+    double l2HitRatio = 0;
+    double ratioOfReads = 0;
+
+    uint64_t tlbCycles = 0;
+    uint64_t pageWalkCycles = 0; // the fixed walk latency, or the radix walks' entry reads
+    uint64_t diskCycles = 0;
+    uint64_t dcCycles = 0;
+    uint64_t l2Cycles = 0;
+    uint64_t memoryCycles = 0;
+    uint64_t totalCycles = 0;
+    double amat = 0; // average cycles per access
+
+    uint64_t dcFillBytes = 0;  // into the DC from L2, or from memory without an L2
+    uint64_t dcWriteBytes = 0; // write-through stores and write-backs leaving the DC
+    uint64_t l2FillBytes = 0;  // into L2 from memory
+    uint64_t l2WriteBytes = 0; // write-backs from L2 to memory
+    uint64_t pageInBytes = 0;  // pages read from disk on faults
+    double memoryBandwidth = 0; // bytes per cycle crossing the memory interface
+
+    PrefetchStats dcPrefetch; // all cores together
+    PrefetchStats l2Prefetch;
+};
+
+// Replacement bookkeeping for every set of one structure, stored set-major in flat
+// arrays. Only the fields of the selected policy are used.
+struct ReplacementState
+{
+    ReplacementPolicy policy = POLICY_LFU;
+    int ways = 0;
+    std::vector<int> validCount;         // per set; ways are filled in order before anything is evicted
+    std::vector<int> hitCount;           // LFU
+    std::vector<int> newer, older;       // LRU recency list per set, most recent at mru
+    std::vector<int> mru, lru;
+    std::vector<unsigned char> treeBits; // PLRU, one bit per internal node pointing at the colder half
+    int treeLeaves = 0;
+    std::vector<int> fifoNext;           // FIFO
+    unsigned int randomState = 0;   // RANDOM
+    std::vector<unsigned char> rrpv;     // SRRIP re-reference prediction values
+};
+
+// Allocates on cache line boundaries so a set's tags never straddle more lines than needed.
+template <typename T>
+struct CacheLineAllocator
+{
+    typedef T value_type;
+
+    CacheLineAllocator() {}
+    template <typename U>
+    CacheLineAllocator(const CacheLineAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        char *raw = static_cast<char *>(std::malloc(n * sizeof(T) + CACHE_LINE_SIZE + sizeof(void *)));
+        if (raw == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void *) + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+        reinterpret_cast<void **>(aligned)[-1] = raw;
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T *p, size_t)
+    {
+        std::free(reinterpret_cast<void **>(p)[-1]);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const CacheLineAllocator<T> &, const CacheLineAllocator<U> &) { return true; }
+template <typename T, typename U>
+bool operator!=(const CacheLineAllocator<T> &, const CacheLineAllocator<U> &) { return false; }
+
+// Open-addressing hash map from virtual page number to the frame holding it,
+// kept in step with pageTableList so translation does not scan the page table.
+struct PageIndex
+{
+    std::vector<uint64_t> virtualPages;
+    std::vector<int> frames; // -1 marks an empty slot
+    unsigned int mask = 0;
+    int hashShift = 0;
+};
+
+// The pool of one huge page size: the resident pages and their replacement, kept like
+// the base pages' pageTableList. Frame f holds the base pages from firstPage + f *
+// basePages on.
+struct HugePageFrames
+{
+    std::vector<Page> pages;
+    ReplacementState replacement;
+    PageIndex index;
+    int lastFrame = -1; // the frame filled by the last fault
+    int firstPage = 0;
+    int basePages = 0;
+};
+
+// A contiguous run of address bits, stored as a shift and a mask so that
+// slicing an address is a single shift-and-mask.
+struct BitField
+{
+    int shift = 0;
+    uint64_t mask = 0;
+
+    uint64_t extract(uint64_t value) const
+    {
+        return (value >> shift) & mask;
+    }
+};
+
+// Fields are described the way the bit widths are printed: bits [startBit, endBit)
+// counted from the most significant bit of a totalBits wide address.
+BitField makeBitField(int startBit, int endBit, int totalBits);
+
+// Precomputed address decoder, derived once from the configuration in calculateBits().
+struct AddressLayout
+{
+    BitField virtualPage;
+    BitField pageOffset;
+    BitField tlbTag;
+    BitField tlbIndex;
+    BitField dcTag;
+    BitField dcIndex;
+    BitField l2Tag;
+    BitField l2Index;
+    int pageOffsetBits = 0;
+
+    uint64_t physicalAddress(int physicalPage, int offset) const
+    {
+        return (static_cast<uint64_t>(physicalPage) << pageOffsetBits) | static_cast<uint64_t>(offset);
+    }
+
+    // Rebuilds the line-aligned physical address of a DC block from its tag and set.
+    uint64_t dcLineAddress(int64_t tag, int index) const
+    {
+        return (static_cast<uint64_t>(tag) << dcTag.shift) | (static_cast<uint64_t>(index) << dcIndex.shift);
+    }
+
+    uint64_t l2LineAddress(int64_t tag, int index) const
+    {
+        return (static_cast<uint64_t>(tag) << l2Tag.shift) | (static_cast<uint64_t>(index) << l2Index.shift);
+    }
+};
+
+void initReplacementState(ReplacementState &state, ReplacementPolicy policy, int numSets, int ways, unsigned int seed);
+void replacementTouch(ReplacementState &state, int set, int way);
+void replacementInsert(ReplacementState &state, int set, int way);
+int replacementVictim(ReplacementState &state, int set);
+
+// Returns the first way of a set whose tag equals tag, or -1. Compares a vector of
+// tags per instruction when built with SSE2 (8 at a time with AVX2).
+inline int matchTag(const int *tags, int ways, int tag)
+{
+    int way = 0;
+#if defined(__AVX2__)
+    __m256i key8 = _mm256_set1_epi32(tag);
+    for (; way + 8 <= ways; way += 8)
+    {
+        __m256i row = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tags + way));
+        int bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(row, key8)));
+        if (bits != 0)
+            return way + __builtin_ctz(bits);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i key4 = _mm_set1_epi32(tag);
+    for (; way + 4 <= ways; way += 4)
+    {
+        __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + way));
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(row, key4)));
+        if (bits != 0)
+            return way + __builtin_ctz(bits);
+    }
+#endif
+    for (; way < ways; way++)
+    {
+        if (tags[way] == tag)
+            return way;
+    }
+    return -1;
+}
+
+// The same for the 64 bit tags of the TLBs, whose tags come from virtual page numbers.
+// SSE2 has no 64 bit compare, so both halves of each tag are compared and combined.
+inline int matchTag(const int64_t *tags, int ways, int64_t tag)
+{
+    int way = 0;
+#if defined(__SSE2__)
+    __m128i key2 = _mm_set1_epi64x(tag);
+    for (; way + 2 <= ways; way += 2)
+    {
+        __m128i halves = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + way)), key2);
+        __m128i equal = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+        int bits = _mm_movemask_pd(_mm_castsi128_pd(equal));
+        if (bits != 0)
+            return way + __builtin_ctz(bits);
+    }
+#endif
+    for (; way < ways; way++)
+    {
+        if (tags[way] == tag)
+            return way;
+    }
+    return -1;
+}
+
+template <typename Tag>
+using TagMatcher = int (*)(const Tag *tags, int ways, Tag tag);
+
+// matchTag with the way count fixed at compile time, so its loops are fully unrolled.
+template <typename Tag, int Ways>
+int matchTagFixed(const Tag *tags, int, Tag tag)
+{
+    return matchTag(tags, Ways, tag);
+}
+
+template <typename Tag>
+TagMatcher<Tag> selectTagMatcher(int ways)
+{
+    switch (ways)
+    {
+    case 1:
+        return matchTagFixed<Tag, 1>;
+    case 2:
+        return matchTagFixed<Tag, 2>;
+    case 4:
+        return matchTagFixed<Tag, 4>;
+    case 8:
+        return matchTagFixed<Tag, 8>;
+    case 16:
+        return matchTagFixed<Tag, 16>;
+    default:
+        return matchTag;
+    }
+}
+
+struct NoPayload
+{
+};
+
+// The line a fill displaced. tag is -1 if the way was empty.
+struct Eviction
+{
+    int64_t tag = -1;
+    bool dirty = false;
+    bool prefetched = false; // brought in by a prefetch and never used
+};
+
+// One set-associative structure (TLB, DC or L2) stored as parallel flat arrays indexed by
+// set * ways + way. Empty ways hold tag -1, which no decoded tag can equal, so a lookup
+// only compares tags. Payload is the data kept per entry (the physical page for the TLB).
+// Ways may be fixed at compile time; otherwise the lookup is specialized at init() for
+// the common shapes and falls back to the runtime-sized matcher for the rest. Tags are
+// 32 bit except in the TLBs and page walk caches.
+template <typename Payload, int Ways = 0, typename Tag = int>
+struct CacheLevel
+{
+    int numSets = 0;
+    int ways = 0;
+    std::vector<Tag, CacheLineAllocator<Tag> > tags;
+    std::vector<unsigned char> valid;
+    std::vector<Payload> payload;
+    std::vector<unsigned char> dirty;      // line holds data not yet written back
+    std::vector<unsigned char> prefetched; // line was prefetched and no demand access has used it yet
+    ReplacementState replacement;
+    TagMatcher<Tag> matcher = matchTag;
+
+    void init(int setCount, int setSize, ReplacementPolicy policy)
+    {
+        numSets = setCount;
+        ways = Ways != 0 ? Ways : setSize;
+        tags.assign(numSets * ways, -1);
+        valid.assign(numSets * ways, 0);
+        payload.assign(numSets * ways, Payload());
+        dirty.assign(numSets * ways, 0);
+        prefetched.assign(numSets * ways, 0);
+        initReplacementState(replacement, policy, numSets, ways, 1);
+        matcher = selectTagMatcher<Tag>(ways);
+    }
+
+    // Returns the way of set holding tag, or -1 on a miss.
+    int lookup(int set, Tag tag) const
+    {
+        if (Ways != 0)
+            return matchTag(&tags[set * Ways], Ways, tag);
+        return matcher(&tags[set * ways], ways, tag);
+    }
+
+    void touch(int set, int way)
+    {
+        replacementTouch(replacement, set, way);
+    }
+
+    // Replaces the victim way of set with a clean line for tag and returns the way used.
+    int fill(int set, Tag tag, Eviction &evicted)
+    {
+        int way = replacementVictim(replacement, set);
+        int line = set * ways + way;
+        evicted.tag = tags[line];
+        evicted.dirty = dirty[line] != 0;
+        evicted.prefetched = prefetched[line] != 0;
+        tags[line] = tag;
+        valid[line] = 1;
+        dirty[line] = 0;
+        prefetched[line] = 0;
+        replacementInsert(replacement, set, way);
+        return way;
+    }
+
+    // If the victim was dirty its tag is left in writeBackTag, otherwise -1.
+    int fill(int set, Tag tag, int64_t &writeBackTag)
+    {
+        Eviction evicted;
+        int way = fill(set, tag, evicted);
+        writeBackTag = evicted.dirty ? evicted.tag : -1;
+        return way;
+    }
+
+    int fill(int set, Tag tag)
+    {
+        int64_t writeBackTag;
+        return fill(set, tag, writeBackTag);
+    }
+
+    void markDirty(int set, int way)
+    {
+        dirty[set * ways + way] = 1;
+    }
+
+    void markClean(int set, int way)
+    {
+        dirty[set * ways + way] = 0;
+    }
+
+    bool isDirty(int set, int way) const
+    {
+        return dirty[set * ways + way] != 0;
+    }
+
+    void markPrefetched(int set, int way)
+    {
+        prefetched[set * ways + way] = 1;
+    }
+
+    // Clears the prefetched mark of a line on its first demand use and returns whether
+    // it was set.
+    bool takePrefetched(int set, int way)
+    {
+        int line = set * ways + way;
+        bool wasPrefetched = prefetched[line] != 0;
+        prefetched[line] = 0;
+        return wasPrefetched;
+    }
+
+    // Empties a way. Its replacement state is left as is, so the way is reused only
+    // when the policy next picks it as a victim.
+    void invalidate(int set, int way)
+    {
+        int line = set * ways + way;
+        tags[line] = -1;
+        valid[line] = 0;
+        dirty[line] = 0;
+        prefetched[line] = 0;
+    }
+
+    Tag tagAt(int set, int way) const
+    {
+        return tags[set * ways + way];
+    }
+
+    Payload &entry(int set, int way)
+    {
+        return payload[set * ways + way];
+    }
+};
+
+struct StrideEntry
+{
+    int64_t page = -1;
+    uint64_t lastAddress = 0;
+    int64_t stride = 0;
+    int confidence = 0;
+};
+
+struct StreamEntry
+{
+    bool valid = false;
+    int64_t lastLine = 0;
+    int direction = 0; // +1 or -1 once two misses have set it
+    int confidence = 0;
+};
+
+// A prefetcher attached to one cache level, with the bookkeeping needed to judge it.
+// Traces carry no program counters, so the stride table is indexed by page.
+struct Prefetcher
+{
+    PrefetcherType type = PREFETCH_NONE;
+    int degree = 1;
+    std::vector<StrideEntry> strideTable;
+    std::vector<StreamEntry> streams;
+    int nextStream = 0;                  // next stream to replace, round robin
+    int pageShift = 0;
+    std::vector<uint64_t> readyCycle;    // per line of the cache: when its prefetch completes
+    std::unordered_set<uint64_t> evictedLines; // lines prefetches evicted and no access has wanted since
+    PrefetchStats counts;
+};
+
+void initPrefetcher(Prefetcher &prefetcher, PrefetcherType type, int degree, int cacheLines, int pageShift);
+// Trains the prefetcher on a demand access and appends the line addresses it wants
+// fetched to candidates. trigger is set for misses and first uses of prefetched lines.
+void prefetchCandidates(Prefetcher &prefetcher, uint64_t address, int lineSize, bool trigger, std::vector<uint64_t> &candidates);
+
+// MESI state of a DC line beyond its valid and dirty bits: a dirty line is Modified, a
+// clean one Shared if another core may hold a copy and Exclusive otherwise.
+struct DCLineState
+{
+    bool shared = false;
+    uint64_t writtenWords = 0; // words stored to since the line was filled, one bit each
+};
+
+// Caches the entries of one upper level of the radix page table, tagged with the
+// virtual page number bits that index that level and the ones above it.
+typedef CacheLevel<NoPayload, 0, int64_t> PageWalkCache;
+
+// The private part of one core: its TLB, its DC and the coherence counters. Only
+// translateAccess touches the TLB and page walk cache fields and only accessCaches the
+// DC fields.
+struct CoreState
+{
+    CacheLevel<int, 0, int64_t> dtlb; // payload: physical page
+    std::vector<PageWalkCache> walkCaches; // one per level above the last, root first
+    // One per huge page size, left empty for sizes cached in dtlb; payload: first base page of the frame
+    std::vector<CacheLevel<int, 0, int64_t> > hugeTLBs;
+    CacheLevel<DCLineState> dataCache;
+    Prefetcher prefetcher; // into dataCache
+    // Lines another core's store took away, with the words that store wrote
+    std::unordered_map<uint64_t, uint64_t> invalidatedLines;
+
+    uint64_t accesses = 0;
+    uint64_t dcHits = 0;
+    uint64_t dcMisses = 0;
+    uint64_t coherenceMisses = 0; // misses on lines lost to an invalidation
+    uint64_t falseSharing = 0;    // coherence misses on a word the other core never wrote
+    uint64_t invalidations = 0;   // copies this core lost to other cores' stores
+    uint64_t upgrades = 0;        // stores to a Shared line that invalidated the other copies
+};
+
+// One simulated memory hierarchy: its configuration, structures and counters. Instances
+// are independent, so several can run in one process (see the sweep mode in main).
+class Simulator
+{
+public:
+    Configuration config;
+    AddressLayout layout;
+    int pageOffSetBits, VPNBits, indexBits, tagBits, totalBits, physicalPageBits;
+    int walkLevelBits = 0;          // virtual page number bits indexing each radix page table level
+    uint64_t pageTableBase = 0;     // physical address of the region holding the radix page table
+    int dcIndexBits, dcOffsetBits, dcTagBits, dcTotalBits;
+    int l2IndexBits, l2OffsetBits, l2TagBits, l2TotalBits;
+
+    std::vector<CoreState> cores;
+    CacheLevel<NoPayload> l2Cache;
+    Prefetcher l2Prefetcher;
+    std::vector<uint64_t> prefetchLines; // candidates of the access being simulated
+    std::vector<Page> pageTableList; // Page Table
+    ReplacementState pageTableReplacement;
+    PageIndex pageIndex;
+    std::vector<HugePageFrames> hugeFrames; // per huge page size
+    int hugeTLBIndexBits[HUGE_PAGE_SIZES] = {};
+    // Radix page table nodes in the order walks first reached them, keyed by level and
+    // the virtual page number bits above it
+    std::unordered_map<uint64_t, int> pageTableNodes;
+    TraceData traceData; // Row for the access being simulated
+
+    uint64_t ptHits = 0;
+    uint64_t ptFaults = 0;
+    uint64_t dcHits = 0;
+    uint64_t dcMisses = 0;
+    uint64_t l2Hits = 0;
+    uint64_t l2Misses = 0;
+    uint64_t totalReads = 0;
+    uint64_t totalWrites = 0;
+    double ratioOfReads = 0;
+    uint64_t mainMemoryRefs = 0;
+    uint64_t pageTableRefs = 0;
+    uint64_t diskRefs = 0;
+    uint64_t dcWriteBacks = 0;  // dirty DC lines written to L2 (or memory without an L2)
+    uint64_t l2WriteBacks = 0;  // dirty L2 lines written to memory
+    uint64_t dcFills = 0;       // lines fetched into the DC
+    uint64_t writeThroughs = 0; // stores the DC passed on without keeping them
+    uint64_t coherenceWriteBacks = 0; // dirty DC lines written back because another core wanted them
+    std::unordered_map<uint64_t, uint64_t> falseSharingLines; // physical line address -> false sharing misses
+    uint64_t pageWalks = 0;     // translation half: radix page table walks
+    uint64_t pteReads = 0;      // cache half: their entry reads
+    uint64_t pteDCHits = 0;
+    uint64_t pteL2Hits = 0;
+    uint64_t pteMemoryRefs = 0;
+    std::vector<uint64_t> walkCacheHits; // per upper level: walks that started below it
+    std::vector<uint64_t> dtlbSizeHits; // per page size, base pages first
+    std::vector<uint64_t> dtlbSizeMisses;
+    std::vector<uint64_t> pageSizeFaults;
+    uint64_t tlbCycles = 0;
+    uint64_t pageWalkCycles = 0;
+    uint64_t diskCycles = 0;
+    uint64_t dcCycles = 0;
+    uint64_t l2Cycles = 0;
+    uint64_t memoryCycles = 0;
+    uint64_t walkCycles = 0; // the radix walks' entry reads, counted by the cache half
+    uint64_t dtlbHits = 0;
+    uint64_t dtlbMisses = 0;
+    double dtlbHitRatio = 0;
+    double ptHitRatio = 0;
+    double dcHitRatio = 0;
+    double l2HitRatio = 0;
+    int currenPhysicalPageAddress = -1;
+    uint64_t trace = 0;
+
+    explicit Simulator(const Configuration &configuration);
+    void initializeMemoryHierarchy();
+    void simulateMemoryAccess(uint64_t virtualAddress, char accessType, int core = 0);
+    uint64_t translateAccess(uint64_t virtualAddress, int core, TraceData &row);
+    void accessCaches(uint64_t physicalAddress, char accessType, TraceData &row);
+    // Reads the page table entries translateAccess left in row; accessCaches starts with it.
+    void replayPageWalk(TraceData &row);
+
+    // Online interface for programs that produce addresses as they run rather than
+    // through a trace file. Accesses are simulated in call order on the calling thread.
+    AccessResult access(uint64_t address, bool isWrite, int core = 0);
+    void accessBatch(const MemoryAccess *accesses, size_t count, AccessResult *results);
+    SimulationStats stats() const;
+    uint64_t totalCycles() const;
+    // Zeroes every counter but keeps the contents of the TLB, page table and caches.
+    void resetStatistics();
+
+    // A checkpoint holds the contents of every structure and every counter, so a run can
+    // be resumed, or several experiments branched from one warmed-up hierarchy. The
+    // configuration restoring it must have the same structures; latencies and prefetchers
+    // may differ. traceOffset is the number of trace records consumed before the save.
+    bool saveCheckpoint(const std::string &filename, uint64_t traceOffset) const;
+    bool loadCheckpoint(const std::string &filename, uint64_t &traceOffset);
+
+    void printConfiguration() const;
+    void printConfig(std::ostream &out) const;
+    void printDTLB();
+    void printPageTable() const;
+    void printDC() const;
+    void printSimulationStatistics(std::ostream &out);
+    void printCoherenceStatistics(std::ostream &out) const;
+    void printPrefetchStatistics(std::ostream &out) const;
+    void printPageWalkStatistics(std::ostream &out) const;
+    void printPageSizeStatistics(std::ostream &out) const;
+    uint64_t tlbReach() const;
+
+private:
+    void calculateBits();
+    void ptinit();
+    void writeBackToL2(uint64_t lineAddress);
+    void forwardFromDC(uint64_t physicalAddress, int pageOffset, char accessType, TraceData &row);
+    void writeBackDCLine(uint64_t lineAddress);
+    int fillL2(int index, int tag, bool prefetch);
+    uint64_t cacheCycles() const;
+    void issueDCPrefetches(int core, uint64_t physicalAddress, bool trigger);
+    void issueL2Prefetches(uint64_t physicalAddress, bool trigger);
+    bool snoopRead(int core, int set, int tag);
+    void snoopInvalidate(int core, int set, int tag, uint64_t lineAddress, uint64_t word);
+    void countCoherenceMiss(CoreState &state, int core, int set, int tag, uint64_t lineAddress, uint64_t word);
+    bool performL2CacheAccess(uint64_t physicalAddess, int pageOffset, char accessType, TraceData &row);
+    void performDataCacheAccess(uint64_t physicalAddess, int pageOffSet, char accessType, TraceData &row);
+    int pageTableNode(int level, uint64_t prefix);
+    void walkPageTable(uint64_t virtualPageNumber, int pageSize, TraceData &row);
+    void readPageTableEntry(int core, uint64_t address);
+    int pageSizeOf(uint64_t virtualAddress) const;
+    int mapPage(std::vector<Page> &pages, ReplacementState &replacement, PageIndex &index, int &lastFrame,
+                uint64_t virtualPage, int pageSize, TraceData &row);
+    Page performPageTableLookup(uint64_t virtualPageNumber, int pageSize, TraceData &row);
+    int performTLBLookup(uint64_t virtualAddress, int pageSize, CoreState &core, TraceData &row);
+    int performHugeTLBLookup(uint64_t virtualPageNumber, int pageSize, CoreState &core, TraceData &row);
+};
+
+ReplacementPolicy parseReplacementPolicy(const std::string &value);
+const char *replacementPolicyName(ReplacementPolicy policy);
+void printReplacementPolicy(std::ostream &out, ReplacementPolicy policy);
+PrefetcherType parsePrefetcher(const std::string &value);
+const char *prefetcherName(PrefetcherType type);
+void printPrefetcher(std::ostream &out, PrefetcherType type, int degree);
+Configuration readConfigFile(const std::string &filename);
+uint64_t pageSizeBytes(const MemoryConfig &config, int pageSize);
+std::string byteSizeLabel(uint64_t bytes);
+double hitRatio(uint64_t hits, uint64_t misses);
+
+void initPageIndex(PageIndex &index, int maxEntries);
+int pageIndexFind(const PageIndex &index, uint64_t virtualPage);
+void pageIndexInsert(PageIndex &index, uint64_t virtualPage, int frame);
+void pageIndexErase(PageIndex &index, uint64_t virtualPage);
+
+#endif
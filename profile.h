@@ -0,0 +1,328 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Optional instrumentation of the simulator's own hot path. Building with
+// -DMEMHIER_PROFILE times five stages of every access:
+//
+//  - parse:     decoding a trace record (nextTraceRecord)
+//  - translate: the TLB and page table (Simulator::translateAccess)
+//  - dc:        the data cache, coherence and DC prefetching (Simulator::accessCaches)
+//  - l2:        the L2 cache and L2 prefetching (Simulator::performL2CacheAccess)
+//  - report:    formatting rows and the miss ratio curves (consumeRow in memhier.cpp)
+//
+// Times are exclusive: L2 accesses made from the DC count towards l2 only. Ticks come
+// from rdtsc on x86 and steady_clock elsewhere. Adding -DMEMHIER_PERF on Linux also
+// counts the host's cycles, instructions and last level cache misses in each stage with
+// perf_event_open; reading them costs a system call per stage change, so use the timers
+// without it to compare stage times. Each thread keeps its own totals, which are summed
+// into the summary printed when memhier exits.
+//
+// Without MEMHIER_PROFILE, PROFILE_SCOPE expands to nothing.
+
+#ifdef MEMHIER_PROFILE
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(MEMHIER_PERF) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MEMHIER_PERF_EVENTS 1
+#endif
+
+enum ProfileStage
+{
+    PROFILE_PARSE,
+    PROFILE_TRANSLATE,
+    PROFILE_DC,
+    PROFILE_L2,
+    PROFILE_REPORT,
+    PROFILE_STAGES
+};
+
+const char *const PROFILE_STAGE_NAMES[] = {"parse", "translate", "dc", "l2", "report"};
+
+enum ProfileCounter
+{
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_MISSES,
+    PROFILE_COUNTERS
+};
+
+struct StageProfile
+{
+    uint64_t calls = 0;
+    uint64_t ticks = 0;
+    uint64_t counters[PROFILE_COUNTERS] = {};
+};
+
+// One per thread. current is the stage being timed, or -1 between stages.
+struct Profiler
+{
+    StageProfile stages[PROFILE_STAGES];
+    int current = -1;
+    uint64_t lastTicks = 0;
+    uint64_t lastCounters[PROFILE_COUNTERS] = {};
+    int perfGroup = -1; // file descriptor of the group leader, or -1 without counters
+
+    Profiler();
+    ~Profiler();
+};
+
+// Totals of the threads that have exited and the profilers of those still running.
+struct ProfileRegistry
+{
+    std::mutex lock;
+    StageProfile finished[PROFILE_STAGES];
+    std::vector<Profiler *> live;
+    bool countersAvailable = false;
+    uint64_t startTicks = 0;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+inline uint64_t profileTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline ProfileRegistry &profileRegistry()
+{
+    static ProfileRegistry registry;
+    return registry;
+}
+
+inline Profiler &threadProfiler()
+{
+    thread_local Profiler profiler;
+    return profiler;
+}
+
+#ifdef MEMHIER_PERF_EVENTS
+inline int openPerfCounter(uint64_t config, int group)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+#endif
+
+// Counts the calling thread's cycles, instructions and LLC misses as one group, so the
+// three are always read together. Leaves perfGroup at -1 if the host refuses.
+inline void openPerfCounters(Profiler &profiler)
+{
+#ifdef MEMHIER_PERF_EVENTS
+    const uint64_t events[PROFILE_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+    int leader = openPerfCounter(events[0], -1);
+    if (leader < 0)
+        return;
+    for (int counter = 1; counter < PROFILE_COUNTERS; counter++)
+    {
+        if (openPerfCounter(events[counter], leader) < 0)
+        {
+            close(leader);
+            return;
+        }
+    }
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    profiler.perfGroup = leader;
+#else
+    (void)profiler;
+#endif
+}
+
+inline bool readPerfCounters(const Profiler &profiler, uint64_t *counters)
+{
+#ifdef MEMHIER_PERF_EVENTS
+    uint64_t group[1 + PROFILE_COUNTERS];
+    if (profiler.perfGroup < 0 || read(profiler.perfGroup, group, sizeof(group)) != static_cast<ssize_t>(sizeof(group)))
+        return false;
+    memcpy(counters, group + 1, sizeof(uint64_t) * PROFILE_COUNTERS);
+    return true;
+#else
+    (void)profiler;
+    (void)counters;
+    return false;
+#endif
+}
+
+inline void addStageProfiles(StageProfile *total, const StageProfile *stages)
+{
+    for (int stage = 0; stage < PROFILE_STAGES; stage++)
+    {
+        total[stage].calls += stages[stage].calls;
+        total[stage].ticks += stages[stage].ticks;
+        for (int counter = 0; counter < PROFILE_COUNTERS; counter++)
+            total[stage].counters[counter] += stages[stage].counters[counter];
+    }
+}
+
+inline Profiler::Profiler()
+{
+    ProfileRegistry &registry = profileRegistry();
+    openPerfCounters(*this);
+    std::lock_guard<std::mutex> guard(registry.lock);
+    if (registry.live.empty() && registry.startTicks == 0)
+    {
+        registry.startTicks = profileTicks();
+        registry.startTime = std::chrono::steady_clock::now();
+    }
+    registry.countersAvailable |= perfGroup >= 0;
+    registry.live.push_back(this);
+}
+
+inline Profiler::~Profiler()
+{
+    ProfileRegistry &registry = profileRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    addStageProfiles(registry.finished, stages);
+    for (size_t i = 0; i < registry.live.size(); i++)
+    {
+        if (registry.live[i] == this)
+        {
+            registry.live.erase(registry.live.begin() + i);
+            break;
+        }
+    }
+#ifdef MEMHIER_PERF_EVENTS
+    if (perfGroup >= 0)
+        close(perfGroup);
+#endif
+}
+
+// Charges the time (and counts) since the last switch to the current stage, then makes
+// next current. The counter read itself is left out of both.
+inline void profileSwitch(Profiler &profiler, int next)
+{
+    uint64_t now = profileTicks();
+    uint64_t counters[PROFILE_COUNTERS];
+    bool counted = readPerfCounters(profiler, counters);
+    if (profiler.current >= 0)
+    {
+        StageProfile &stage = profiler.stages[profiler.current];
+        stage.ticks += now - profiler.lastTicks;
+        for (int counter = 0; counted && counter < PROFILE_COUNTERS; counter++)
+            stage.counters[counter] += counters[counter] - profiler.lastCounters[counter];
+    }
+    if (counted)
+        memcpy(profiler.lastCounters, counters, sizeof(counters));
+    profiler.current = next;
+    profiler.lastTicks = profileTicks();
+}
+
+// Times its enclosing block as stage, pausing whichever stage it interrupted.
+struct ProfileScope
+{
+    Profiler &profiler;
+    int outer;
+
+    explicit ProfileScope(ProfileStage stage) : profiler(threadProfiler()), outer(profiler.current)
+    {
+        profiler.stages[stage].calls++;
+        profileSwitch(profiler, stage);
+    }
+    ~ProfileScope()
+    {
+        profileSwitch(profiler, outer);
+    }
+};
+
+// Prints the stage totals of every thread so far.
+inline void printProfile(std::ostream &out)
+{
+    ProfileRegistry &registry = profileRegistry();
+    StageProfile total[PROFILE_STAGES];
+    bool counters;
+    {
+        std::lock_guard<std::mutex> guard(registry.lock);
+        addStageProfiles(total, registry.finished);
+        for (const Profiler *profiler : registry.live)
+            addStageProfiles(total, profiler->stages);
+        counters = registry.countersAvailable;
+    }
+    // Ticks are converted to seconds at the rate they advanced since the first profiler
+    double elapsed = 0;
+    double ticksPerSecond = 1;
+    if (registry.startTicks != 0)
+    {
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - registry.startTime).count();
+        ticksPerSecond = elapsed > 0 ? (profileTicks() - registry.startTicks) / elapsed : 1;
+    }
+    uint64_t profiledTicks = 0;
+    for (const StageProfile &stage : total)
+        profiledTicks += stage.ticks;
+
+    std::ios_base::fmtflags flags = out.flags();
+    out << std::endl
+        << "Simulator profile" << (counters ? "" : " (no perf counters)") << std::endl
+        << std::endl;
+    out << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "calls" << std::setw(12) << "seconds"
+        << std::setw(8) << "share" << std::setw(10) << "ns/call";
+    if (counters)
+        out << std::setw(16) << "cycles" << std::setw(16) << "instructions" << std::setw(7) << "IPC" << std::setw(12) << "LLC misses";
+    out << std::endl;
+    for (int stage = 0; stage < PROFILE_STAGES; stage++)
+    {
+        const StageProfile &profile = total[stage];
+        double seconds = profile.ticks / ticksPerSecond;
+        out << std::left << std::setw(10) << PROFILE_STAGE_NAMES[stage] << std::right << std::setw(12) << profile.calls
+            << std::fixed << std::setprecision(6) << std::setw(12) << seconds << std::setprecision(1) << std::setw(7)
+            << (profiledTicks > 0 ? 100.0 * profile.ticks / profiledTicks : 0) << "%" << std::setw(10)
+            << (profile.calls > 0 ? 1e9 * seconds / profile.calls : 0);
+        if (counters)
+        {
+            const uint64_t *count = profile.counters;
+            out << std::setw(16) << count[COUNTER_CYCLES] << std::setw(16) << count[COUNTER_INSTRUCTIONS] << std::setprecision(2)
+                << std::setw(7) << (count[COUNTER_CYCLES] > 0 ? static_cast<double>(count[COUNTER_INSTRUCTIONS]) / count[COUNTER_CYCLES] : 0)
+                << std::setw(12) << count[COUNTER_LLC_MISSES];
+        }
+        out << std::endl;
+    }
+    out << std::left << std::setw(10) << "total" << std::right << std::setw(12) << "" << std::setprecision(6) << std::setw(12)
+        << profiledTicks / ticksPerSecond << "   across all threads, " << elapsed << " s wall" << std::endl;
+    out.flags(flags);
+}
+
+// Prints the profile when it goes out of scope, e.g. at the end of main.
+struct ProfileSummary
+{
+    std::ostream &out;
+    explicit ProfileSummary(std::ostream &stream) : out(stream) {}
+    ~ProfileSummary()
+    {
+        printProfile(out);
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage)
+
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "memhier.h"
+
+// The per-access report: a buffer shared by every destination (trace_out.txt and
+// stdout in memhier) and the formatting of its rows.
+
+const size_t REPORT_BUFFER_SIZE = 1 << 20;
+const size_t MAX_TRACE_ROW_SIZE = 256;
+
+// Buffered output shared by every report destination, so each row is formatted once.
+struct ReportWriter
+{
+    std::vector<FILE *> files;
+    std::vector<char> buffer;
+    size_t used = 0;
+};
+
+inline void openReport(ReportWriter &report)
+{
+    report.buffer.resize(REPORT_BUFFER_SIZE);
+    report.used = 0;
+}
+
+inline void reportFlush(ReportWriter &report)
+{
+    for (FILE *file : report.files)
+    {
+        fwrite(report.buffer.data(), 1, report.used, file);
+    }
+    report.used = 0;
+}
+
+// Returns room for at least size bytes at the end of the buffer; the caller advances used.
+inline char *reportReserve(ReportWriter &report, size_t size)
+{
+    if (report.buffer.size() - report.used < size)
+    {
+        reportFlush(report);
+    }
+    return report.buffer.data() + report.used;
+}
+
+inline void reportWrite(ReportWriter &report, const std::string &text)
+{
+    if (text.size() > report.buffer.size())
+    {
+        reportFlush(report);
+        for (FILE *file : report.files)
+        {
+            fwrite(text.data(), 1, text.size(), file);
+        }
+        return;
+    }
+    char *out = reportReserve(report, text.size());
+    memcpy(out, text.data(), text.size());
+    report.used += text.size();
+}
+
+inline void closeReport(ReportWriter &report)
+{
+    reportFlush(report);
+    for (FILE *file : report.files)
+    {
+        if (file != stdout)
+        {
+            fclose(file);
+        }
+    }
+    report.files.clear();
+}
+
+// Appends value in hex, right aligned in a field of at least width characters.
+inline char *appendHex(char *out, uint64_t value, int width)
+{
+    static const char digits[] = "0123456789abcdef";
+    char scratch[16];
+    int length = 0;
+    do
+    {
+        scratch[length++] = digits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    for (int i = length; i < width; i++)
+    {
+        *out++ = ' ';
+    }
+    while (length > 0)
+    {
+        *out++ = scratch[--length];
+    }
+    return out;
+}
+
+// Appends value in hex, or nothing if the field was not filled in for this access.
+inline char *appendOptionalHex(char *out, int64_t value, int width)
+{
+    return value >= 0 ? appendHex(out, static_cast<uint64_t>(value), width) : out;
+}
+
+inline char *appendString(char *out, const char *text, int width)
+{
+    int length = 0;
+    while (text[length] != '\0')
+    {
+        *out++ = text[length++];
+    }
+    for (; length < width; length++)
+    {
+        *out++ = ' ';
+    }
+    return out;
+}
+
+inline void printTraceData(ReportWriter &report, const TraceData &row)
+{
+    char *out = reportReserve(report, MAX_TRACE_ROW_SIZE);
+    char *start = out;
+    // Eight digits with leading zeros, more for addresses past 32 bits
+    uint64_t virtualAddress = static_cast<uint64_t>(row.virtualAddress);
+    int digits = 8;
+    while (digits < 16 && (virtualAddress >> (4 * digits)) != 0)
+    {
+        digits++;
+    }
+    for (int shift = 4 * (digits - 1); shift >= 0; shift -= 4)
+    {
+        *out++ = "0123456789abcdef"[(virtualAddress >> shift) & 0xf];
+    }
+    *out++ = ' ';
+    out = appendOptionalHex(out, row.virtualPage, 6);
+    *out++ = ' ';
+    out = appendOptionalHex(out, row.pageOffset, 4);
+    *out++ = ' ';
+    out = appendOptionalHex(out, row.tlbTag, 6);
+    *out++ = ' ';
+    out = appendOptionalHex(out, row.tlbIndex, 3);
+    *out++ = ' ';
+    out = appendString(out, row.tlbRes, 4);
+    *out++ = ' ';
+    out = appendString(out, row.ptRes, 4);
+    *out++ = ' ';
+    out = appendHex(out, static_cast<unsigned int>(row.physicalPage), 4);
+    *out++ = ' ';
+    out = appendOptionalHex(out, row.dcTag, 6);
+    *out++ = ' ';
+    out = appendOptionalHex(out, row.dcIndex, 3);
+    *out++ = ' ';
+    out = appendString(out, row.dcRes, 4);
+    if (row.l2Index >= 0)
+    {
+        *out++ = ' ';
+        out = appendOptionalHex(out, row.l2Tag, 6);
+        *out++ = ' ';
+        out = appendHex(out, row.l2Index, 3);
+    }
+    *out++ = ' ';
+    out = appendString(out, row.l2Res, 0);
+    *out++ = '\n';
+    report.used += out - start;
+}
+
+inline void printHeader(ReportWriter &report)
+{
+    reportWrite(report, "Virtual  Virt.  Page TLB    TLB TLB  PT   Phys        DC  DC          L2  L2\n");
+    reportWrite(report, "Address  Page # Off  Tag    Ind Res. Res. Pg # DC Tag Ind Res. L2 Tag Ind Res.\n");
+    reportWrite(report, "-------- ------ ---- ------ --- ---- ---- ---- ------ --- ---- ------ --- ----\n");
+}
+
+#endif
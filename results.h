@@ -0,0 +1,382 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "memhier.h"
+
+// Structured results for scripts: the configuration, the bit widths derived from it and
+// the final statistics of a run, as one JSON object per line or one CSV row per run
+// (with a header row first). Every run has the same fields in the same order, so the
+// results of a sweep, or of many separate runs, concatenate into one table. The
+// per-access rows can go to a second file in the same format, with decimal numbers and
+// empty (CSV) or null (JSON) fields for levels an access did not reach.
+
+enum ResultsFormat
+{
+    RESULTS_JSON,
+    RESULTS_CSV
+};
+
+struct ResultField
+{
+    std::string name;
+    std::string value;
+    bool text; // quoted in JSON
+};
+
+struct ResultSection
+{
+    const char *name;
+    std::vector<ResultField> fields;
+};
+
+const size_t RESULT_ROW_SIZE = 1024;
+const char RESULT_ROW_COLUMNS[] = "core,virtual_address,virtual_page,page_offset,tlb_tag,tlb_index,tlb_result,pt_result,"
+                                  "physical_page,dc_tag,dc_index,dc_result,l2_tag,l2_index,l2_result";
+
+inline bool parseResultsFormat(const std::string &name, ResultsFormat &format)
+{
+    if (name == "json")
+        format = RESULTS_JSON;
+    else if (name == "csv")
+        format = RESULTS_CSV;
+    else
+        return false;
+    return true;
+}
+
+inline void addResult(ResultSection &section, const char *name, long long value)
+{
+    section.fields.push_back({name, std::to_string(value), false});
+}
+
+inline void addResult(ResultSection &section, const char *name, uint64_t value)
+{
+    section.fields.push_back({name, std::to_string(value), false});
+}
+
+inline void addResult(ResultSection &section, const char *name, int value)
+{
+    addResult(section, name, static_cast<long long>(value));
+}
+
+inline void addResult(ResultSection &section, const char *name, double value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.6f", value);
+    section.fields.push_back({name, text, false});
+}
+
+inline void addResult(ResultSection &section, const char *name, const std::string &value)
+{
+    section.fields.push_back({name, value, true});
+}
+
+inline void addPrefetchResults(ResultSection &section, const char *prefix, const PrefetchStats &stats)
+{
+    std::string name = prefix;
+    section.fields.push_back({name + "_prefetches", std::to_string(stats.issued), false});
+    section.fields.push_back({name + "_prefetches_useful", std::to_string(stats.useful), false});
+    section.fields.push_back({name + "_prefetches_late", std::to_string(stats.late), false});
+    section.fields.push_back({name + "_prefetches_unused", std::to_string(stats.unused), false});
+    section.fields.push_back({name + "_prefetch_pollution_misses", std::to_string(stats.pollutionMisses), false});
+}
+
+// x86-64 names of the page table entries mapping each page size, base pages first, which
+// name the page size fields independently of the base page size.
+const char *const PAGE_SIZE_ENTRY_NAMES[] = {"pte", "pde", "pdpte"};
+
+inline void addPageSizeResults(ResultSection &section, const SimulationStats &stats)
+{
+    for (int size = 0; size <= HUGE_PAGE_SIZES; size++)
+    {
+        std::string name = PAGE_SIZE_ENTRY_NAMES[size];
+        section.fields.push_back({"dtlb_" + name + "_hits", std::to_string(stats.dtlbSizeHits[size]), false});
+        section.fields.push_back({"dtlb_" + name + "_misses", std::to_string(stats.dtlbSizeMisses[size]), false});
+        section.fields.push_back({"pt_" + name + "_faults", std::to_string(stats.pageSizeFaults[size]), false});
+    }
+}
+
+// Everything reported for one simulator; name identifies its configuration file.
+inline std::vector<ResultSection> simulationResults(const Simulator &simulator, const std::string &name)
+{
+    const Configuration &config = simulator.config;
+    std::vector<ResultSection> sections(4);
+
+    ResultSection &run = sections[0];
+    run.name = "run";
+    addResult(run, "config_file", name);
+
+    ResultSection &configuration = sections[1];
+    configuration.name = "configuration";
+    addResult(configuration, "dtlb_sets", config.dtlbConfig.numSets);
+    addResult(configuration, "dtlb_ways", config.dtlbConfig.setSize);
+    addResult(configuration, "dtlb_policy", std::string(replacementPolicyName(config.dtlbConfig.policy)));
+    addResult(configuration, "virtual_pages", config.ptConfig.numVirtualPages);
+    addResult(configuration, "physical_pages", config.ptConfig.numPhysicalPages);
+    addResult(configuration, "page_size", config.ptConfig.pageSize);
+    addResult(configuration, "pt_policy", std::string(replacementPolicyName(config.ptConfig.policy)));
+    addResult(configuration, "pt_levels", config.ptConfig.levels);
+    addResult(configuration, "walk_cache_entries", config.ptConfig.walkCacheEntries);
+    for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+    {
+        std::string name = PAGE_SIZE_ENTRY_NAMES[size];
+        const HugePageConfig &hugePages = config.ptConfig.hugePages[size - 1];
+        configuration.fields.push_back({name + "_pages", std::to_string(hugePages.numPages), false});
+        configuration.fields.push_back({name + "_tlb_sets", std::to_string(hugePages.tlbSets), false});
+        configuration.fields.push_back({name + "_tlb_ways", std::to_string(hugePages.tlbSetSize), false});
+    }
+    addResult(configuration, "huge_page_regions", static_cast<int>(config.ptConfig.hugePageRegions.size()));
+    addResult(configuration, "dc_sets", config.dcConfig.numSets);
+    addResult(configuration, "dc_ways", config.dcConfig.setSize);
+    addResult(configuration, "dc_line_size", config.dcConfig.lineSize);
+    addResult(configuration, "dc_write_through", static_cast<long long>(config.dcConfig.writeThroughOrNoWriteAllocate));
+    addResult(configuration, "dc_policy", std::string(replacementPolicyName(config.dcConfig.policy)));
+    addResult(configuration, "dc_prefetcher", std::string(prefetcherName(config.dcConfig.prefetcher)));
+    addResult(configuration, "dc_prefetch_degree", config.dcConfig.prefetchDegree);
+    addResult(configuration, "l2_sets", config.l2Config.numSets);
+    addResult(configuration, "l2_ways", config.l2Config.setSize);
+    addResult(configuration, "l2_line_size", config.l2Config.lineSize);
+    addResult(configuration, "l2_policy", std::string(replacementPolicyName(config.l2Config.policy)));
+    addResult(configuration, "l2_prefetcher", std::string(prefetcherName(config.l2Config.prefetcher)));
+    addResult(configuration, "l2_prefetch_degree", config.l2Config.prefetchDegree);
+    addResult(configuration, "virtual_addresses", static_cast<long long>(config.useVirtualAddresses));
+    addResult(configuration, "use_tlb", static_cast<long long>(config.useTLB));
+    addResult(configuration, "use_l2", static_cast<long long>(config.useL2Cache));
+    addResult(configuration, "cores", config.numCores);
+    addResult(configuration, "tlb_latency", config.timing.tlbLatency);
+    addResult(configuration, "page_walk_latency", config.timing.pageWalkLatency);
+    addResult(configuration, "dc_latency", config.timing.dcLatency);
+    addResult(configuration, "l2_latency", config.timing.l2Latency);
+    addResult(configuration, "memory_latency", config.timing.memoryLatency);
+    addResult(configuration, "disk_latency", config.timing.diskLatency);
+
+    // The widths printConfig reports
+    ResultSection &bits = sections[2];
+    bits.name = "bits";
+    addResult(bits, "virtual_address_bits", simulator.totalBits);
+    addResult(bits, "dtlb_index_bits", simulator.indexBits);
+    addResult(bits, "pt_index_bits", simulator.physicalPageBits);
+    addResult(bits, "page_offset_bits", simulator.pageOffSetBits);
+    addResult(bits, "dc_index_bits", simulator.dcIndexBits);
+    addResult(bits, "dc_offset_bits", simulator.dcOffsetBits);
+    addResult(bits, "l2_index_bits", simulator.l2IndexBits);
+    addResult(bits, "l2_offset_bits", simulator.l2OffsetBits);
+
+    SimulationStats stats = simulator.stats();
+    ResultSection &statistics = sections[3];
+    statistics.name = "statistics";
+    addResult(statistics, "dtlb_hits", stats.dtlbHits);
+    addResult(statistics, "dtlb_misses", stats.dtlbMisses);
+    addResult(statistics, "dtlb_hit_ratio", stats.dtlbHitRatio);
+    addResult(statistics, "pt_hits", stats.ptHits);
+    addResult(statistics, "pt_faults", stats.ptFaults);
+    addResult(statistics, "pt_hit_ratio", stats.ptHitRatio);
+    addResult(statistics, "dc_hits", stats.dcHits);
+    addResult(statistics, "dc_misses", stats.dcMisses);
+    addResult(statistics, "dc_hit_ratio", stats.dcHitRatio);
+    addResult(statistics, "l2_hits", stats.l2Hits);
+    addResult(statistics, "l2_misses", stats.l2Misses);
+    addResult(statistics, "l2_hit_ratio", stats.l2HitRatio);
+    addResult(statistics, "reads", stats.totalReads);
+    addResult(statistics, "writes", stats.totalWrites);
+    addResult(statistics, "read_ratio", stats.ratioOfReads);
+    addResult(statistics, "memory_refs", stats.mainMemoryRefs);
+    addResult(statistics, "page_table_refs", stats.pageTableRefs);
+    addResult(statistics, "disk_refs", stats.diskRefs);
+    addResult(statistics, "dc_write_backs", stats.dcWriteBacks);
+    addResult(statistics, "l2_write_backs", stats.l2WriteBacks);
+    addResult(statistics, "coherence_misses", stats.coherenceMisses);
+    addResult(statistics, "invalidations", stats.invalidations);
+    addResult(statistics, "upgrades", stats.upgrades);
+    addResult(statistics, "false_sharing", stats.falseSharing);
+    addResult(statistics, "coherence_write_backs", stats.coherenceWriteBacks);
+    addResult(statistics, "page_walks", stats.pageWalks);
+    addResult(statistics, "walk_cache_hits", stats.walkCacheHits);
+    addResult(statistics, "pte_reads", stats.pteReads);
+    addResult(statistics, "pte_dc_hits", stats.pteDCHits);
+    addResult(statistics, "pte_l2_hits", stats.pteL2Hits);
+    addResult(statistics, "pte_memory_refs", stats.pteMemoryRefs);
+    addPageSizeResults(statistics, stats);
+    addResult(statistics, "tlb_reach_bytes", static_cast<long long>(stats.tlbReach));
+    addResult(statistics, "cycles", static_cast<long long>(stats.totalCycles));
+    addResult(statistics, "amat", stats.amat);
+    addResult(statistics, "dc_fill_bytes", static_cast<long long>(stats.dcFillBytes));
+    addResult(statistics, "dc_write_bytes", static_cast<long long>(stats.dcWriteBytes));
+    addResult(statistics, "l2_fill_bytes", static_cast<long long>(stats.l2FillBytes));
+    addResult(statistics, "l2_write_bytes", static_cast<long long>(stats.l2WriteBytes));
+    addResult(statistics, "page_in_bytes", static_cast<long long>(stats.pageInBytes));
+    addResult(statistics, "memory_bytes_per_cycle", stats.memoryBandwidth);
+    addPrefetchResults(statistics, "dc", stats.dcPrefetch);
+    addPrefetchResults(statistics, "l2", stats.l2Prefetch);
+    return sections;
+}
+
+inline std::string jsonString(const std::string &value)
+{
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+            continue;
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+inline std::string csvField(const std::string &value)
+{
+    if (value.find_first_of(",\"\n") == std::string::npos)
+        return value;
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+inline void writeResultsJson(FILE *file, const std::vector<ResultSection> &sections)
+{
+    std::string line = "{";
+    for (size_t s = 0; s < sections.size(); s++)
+    {
+        line += (s > 0 ? ",\"" : "\"") + std::string(sections[s].name) + "\":{";
+        for (size_t f = 0; f < sections[s].fields.size(); f++)
+        {
+            const ResultField &field = sections[s].fields[f];
+            line += (f > 0 ? ",\"" : "\"") + field.name + "\":" + (field.text ? jsonString(field.value) : field.value);
+        }
+        line += "}";
+    }
+    line += "}\n";
+    fwrite(line.data(), 1, line.size(), file);
+}
+
+inline void writeResultsCsv(FILE *file, const std::vector<ResultSection> &sections, bool header)
+{
+    std::string line;
+    for (int pass = header ? 0 : 1; pass < 2; pass++)
+    {
+        line.clear();
+        for (const ResultSection &section : sections)
+        {
+            for (const ResultField &field : section.fields)
+            {
+                line += (line.empty() ? "" : ",") + csvField(pass == 0 ? field.name : field.value);
+            }
+        }
+        line += "\n";
+        fwrite(line.data(), 1, line.size(), file);
+    }
+}
+
+// Writes the results of every simulator, named by its configuration file, as one table.
+inline void writeResults(FILE *file, ResultsFormat format, const std::vector<const Simulator *> &simulators,
+                         const std::vector<std::string> &names)
+{
+    for (size_t i = 0; i < simulators.size(); i++)
+    {
+        std::vector<ResultSection> sections = simulationResults(*simulators[i], names[i]);
+        if (format == RESULTS_JSON)
+            writeResultsJson(file, sections);
+        else
+            writeResultsCsv(file, sections, i == 0);
+    }
+    fflush(file);
+}
+
+// Per-access rows, formatted into a fixed buffer and written through stdio.
+struct ResultRowsWriter
+{
+    FILE *file = nullptr;
+    ResultsFormat format = RESULTS_JSON;
+};
+
+inline bool openResultRows(ResultRowsWriter &writer, const std::string &filename, ResultsFormat format)
+{
+    writer.file = filename == "-" ? stdout : fopen(filename.c_str(), "w");
+    writer.format = format;
+    if (writer.file == nullptr)
+    {
+        std::cerr << "Error: Unable to open results rows file " << filename << "." << std::endl;
+        return false;
+    }
+    if (format == RESULTS_CSV)
+    {
+        fprintf(writer.file, "%s\n", RESULT_ROW_COLUMNS);
+    }
+    return true;
+}
+
+// Appends one field of a row; negative numbers mark fields the access did not fill in.
+inline void appendRowField(char *row, size_t &used, bool json, const char *name, long long value)
+{
+    int length;
+    if (json)
+        length = value >= 0 ? snprintf(row + used, RESULT_ROW_SIZE - used, ",\"%s\":%lld", name, value)
+                            : snprintf(row + used, RESULT_ROW_SIZE - used, ",\"%s\":null", name);
+    else
+        length = value >= 0 ? snprintf(row + used, RESULT_ROW_SIZE - used, ",%lld", value) : snprintf(row + used, RESULT_ROW_SIZE - used, ",");
+    used += length > 0 ? static_cast<size_t>(length) : 0;
+}
+
+// Results are "hit ", "miss" or empty in TraceData.
+inline void appendRowResult(char *row, size_t &used, bool json, const char *name, const char *result)
+{
+    const char *value = result[0] == 'h' ? "hit" : (result[0] == 'm' ? "miss" : "");
+    int length;
+    if (json)
+        length = value[0] != '\0' ? snprintf(row + used, RESULT_ROW_SIZE - used, ",\"%s\":\"%s\"", name, value)
+                                  : snprintf(row + used, RESULT_ROW_SIZE - used, ",\"%s\":null", name);
+    else
+        length = snprintf(row + used, RESULT_ROW_SIZE - used, ",%s", value);
+    used += length > 0 ? static_cast<size_t>(length) : 0;
+}
+
+inline void writeResultRow(ResultRowsWriter &writer, const TraceData &row)
+{
+    bool json = writer.format == RESULTS_JSON;
+    char line[RESULT_ROW_SIZE];
+    int length = json ? snprintf(line, sizeof(line), "{\"core\":%d", row.core) : snprintf(line, sizeof(line), "%d", row.core);
+    size_t used = length > 0 ? static_cast<size_t>(length) : 0;
+    appendRowField(line, used, json, "virtual_address", row.virtualAddress);
+    appendRowField(line, used, json, "virtual_page", row.virtualPage);
+    appendRowField(line, used, json, "page_offset", row.pageOffset);
+    appendRowField(line, used, json, "tlb_tag", row.tlbTag);
+    appendRowField(line, used, json, "tlb_index", row.tlbIndex);
+    appendRowResult(line, used, json, "tlb_result", row.tlbRes);
+    appendRowResult(line, used, json, "pt_result", row.ptRes);
+    appendRowField(line, used, json, "physical_page", row.physicalPage);
+    appendRowField(line, used, json, "dc_tag", row.dcTag);
+    appendRowField(line, used, json, "dc_index", row.dcIndex);
+    appendRowResult(line, used, json, "dc_result", row.dcRes);
+    appendRowField(line, used, json, "l2_tag", row.l2Tag);
+    appendRowField(line, used, json, "l2_index", row.l2Index);
+    appendRowResult(line, used, json, "l2_result", row.l2Res);
+    fwrite(line, 1, used, writer.file);
+    fputs(json ? "}\n" : "\n", writer.file);
+}
+
+inline void closeResultRows(ResultRowsWriter &writer)
+{
+    if (writer.file != nullptr)
+    {
+        if (writer.file != stdout)
+            fclose(writer.file);
+        else
+            fflush(stdout);
+        writer.file = nullptr;
+    }
+}
+
+#endif
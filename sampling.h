@@ -0,0 +1,160 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+// Estimates for sampled simulation. A sampled run measures a number of clusters (DC sets,
+// or intervals of the trace) and estimates each statistic as a ratio y / x summed over
+// the clusters, e.g. DC hits over DC lookups. Its confidence interval comes from the
+// spread of the clusters around that ratio (the ratio estimator's variance), with the
+// finite population correction for the fraction of the trace that was measured.
+
+const double SAMPLE_Z95 = 1.96; // normal quantile of a two-sided 95% interval
+
+// Outcome counts of one cluster.
+struct SampleCounts
+{
+    double accesses = 0;
+    double dtlbHits = 0;
+    double dtlbLookups = 0;
+    double ptHits = 0;
+    double ptLookups = 0;
+    double dcHits = 0;
+    double dcLookups = 0;
+    double l2Hits = 0;
+    double l2Lookups = 0;
+    double cycles = 0;
+};
+
+struct RatioSample
+{
+    double sumY = 0;
+    double sumX = 0;
+    double sumYY = 0;
+    double sumXY = 0;
+    double sumXX = 0;
+    uint64_t clusters = 0;
+};
+
+inline void addRatioSample(RatioSample &sample, double y, double x)
+{
+    sample.sumY += y;
+    sample.sumX += x;
+    sample.sumYY += y * y;
+    sample.sumXY += x * y;
+    sample.sumXX += x * x;
+    sample.clusters++;
+}
+
+inline double ratioEstimate(const RatioSample &sample)
+{
+    return sample.sumX > 0 ? sample.sumY / sample.sumX : 0;
+}
+
+// Half width of the 95% confidence interval of ratioEstimate, or 0 when the clusters
+// saw nothing. It needs at least two clusters. sampledFraction is the share of the
+// population the clusters cover.
+inline double ratioHalfWidth(const RatioSample &sample, double sampledFraction)
+{
+    double m = static_cast<double>(sample.clusters);
+    if (sample.sumX <= 0)
+    {
+        return 0;
+    }
+    double ratio = sample.sumY / sample.sumX;
+    double meanX = sample.sumX / m;
+    // Sum over clusters of (y - ratio * x)^2
+    double residuals = sample.sumYY - 2 * ratio * sample.sumXY + ratio * ratio * sample.sumXX;
+    double variance = std::max(residuals, 0.0) / (m * (m - 1) * meanX * meanX);
+    variance *= std::max(1 - sampledFraction, 0.0);
+    return SAMPLE_Z95 * std::sqrt(variance);
+}
+
+// Every statistic a sampled run reports, accumulated cluster by cluster.
+struct SampleEstimates
+{
+    RatioSample dtlbHitRatio;
+    RatioSample ptHitRatio;
+    RatioSample dcHitRatio;
+    RatioSample l2HitRatio;
+    RatioSample amat;
+    RatioSample dcMissesPerAccess;
+    RatioSample l2MissesPerAccess;
+    uint64_t measuredAccesses = 0;
+};
+
+inline void addSampleCluster(SampleEstimates &estimates, const SampleCounts &counts)
+{
+    addRatioSample(estimates.dtlbHitRatio, counts.dtlbHits, counts.dtlbLookups);
+    addRatioSample(estimates.ptHitRatio, counts.ptHits, counts.ptLookups);
+    addRatioSample(estimates.dcHitRatio, counts.dcHits, counts.dcLookups);
+    addRatioSample(estimates.l2HitRatio, counts.l2Hits, counts.l2Lookups);
+    addRatioSample(estimates.amat, counts.cycles, counts.accesses);
+    addRatioSample(estimates.dcMissesPerAccess, counts.dcLookups - counts.dcHits, counts.accesses);
+    addRatioSample(estimates.l2MissesPerAccess, counts.l2Lookups - counts.l2Hits, counts.accesses);
+    estimates.measuredAccesses += static_cast<uint64_t>(counts.accesses);
+}
+
+// Prints every estimate with its 95% confidence interval; miss counts are extrapolated
+// to all totalAccesses of the trace.
+inline void printSampledStatistics(std::ostream &out, const std::string &method, const SampleEstimates &estimates,
+                                   uint64_t totalAccesses, double sampledFraction)
+{
+    out << std::endl
+        << "Sampled statistics" << std::endl
+        << std::endl;
+    out << std::left << std::setw(17) << "sampling" << ": " << method << std::endl;
+    out << std::left << std::setw(17) << "clusters" << ": " << estimates.dcHitRatio.clusters << std::endl;
+    out << std::left << std::setw(17) << "measured" << ": " << estimates.measuredAccesses << " of " << totalAccesses
+        << " accesses" << std::endl
+        << std::endl;
+    out << std::left << std::setw(17) << "" << "  " << std::right << std::setw(14) << "estimate" << std::setw(14) << "95% CI +/-" << std::endl;
+    // One cluster gives no spread to estimate an interval from
+    bool intervals = estimates.dcHitRatio.clusters >= 2;
+
+    const struct
+    {
+        const char *label;
+        const RatioSample *sample;
+    } ratioRows[] = {
+        {"dtlb hit ratio", &estimates.dtlbHitRatio},
+        {"pt hit ratio", &estimates.ptHitRatio},
+        {"dc hit ratio", &estimates.dcHitRatio},
+        {"L2 hit ratio", &estimates.l2HitRatio},
+        {"AMAT (cycles)", &estimates.amat},
+    };
+    for (const auto &row : ratioRows)
+    {
+        out << std::left << std::setw(17) << row.label << ": " << std::right << std::fixed << std::setprecision(6)
+            << std::setw(14) << ratioEstimate(*row.sample) << std::setw(14);
+        if (intervals)
+            out << ratioHalfWidth(*row.sample, sampledFraction) << std::endl;
+        else
+            out << "n/a" << std::endl;
+    }
+    const struct
+    {
+        const char *label;
+        const RatioSample *sample;
+    } countRows[] = {
+        {"dc misses", &estimates.dcMissesPerAccess},
+        {"L2 misses", &estimates.l2MissesPerAccess},
+    };
+    for (const auto &row : countRows)
+    {
+        double scale = static_cast<double>(totalAccesses);
+        out << std::left << std::setw(17) << row.label << ": " << std::right << std::fixed << std::setprecision(0)
+            << std::setw(14) << ratioEstimate(*row.sample) * scale << std::setw(14);
+        if (intervals)
+            out << ratioHalfWidth(*row.sample, sampledFraction) * scale << std::endl;
+        else
+            out << "n/a" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,3167 @@
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <iomanip>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <limits>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include "memhier.h"
+#include "profile.h"
+
+using namespace std;
+
+// Fields are described the way the bit widths are printed: bits [startBit, endBit)
+// counted from the most significant bit of a totalBits wide address.
+BitField makeBitField(int startBit, int endBit, int totalBits)
+{
+    BitField field;
+    int width = endBit - startBit;
+    field.shift = max(totalBits - endBit, 0);
+    if (width <= 0)
+    {
+        field.mask = 0;
+    }
+    else if (width >= MAX_BITS)
+    {
+        field.mask = ~0ull;
+    }
+    else
+    {
+        field.mask = (1ull << width) - 1;
+    }
+    return field;
+}
+
+void initReplacementState(ReplacementState &state, ReplacementPolicy policy, int numSets, int ways, unsigned int seed)
+{
+    state = ReplacementState();
+    state.policy = policy;
+    state.ways = ways;
+    state.validCount.assign(numSets, 0);
+    switch (policy)
+    {
+    case POLICY_LFU:
+        state.hitCount.assign(numSets * ways, 0);
+        break;
+    case POLICY_LRU:
+        state.newer.assign(numSets * ways, -1);
+        state.older.assign(numSets * ways, -1);
+        state.mru.assign(numSets, -1);
+        state.lru.assign(numSets, -1);
+        break;
+    case POLICY_PLRU:
+        state.treeLeaves = 1;
+        while (state.treeLeaves < ways)
+        {
+            state.treeLeaves *= 2;
+        }
+        state.treeBits.assign(numSets * state.treeLeaves, 0);
+        break;
+    case POLICY_FIFO:
+        state.fifoNext.assign(numSets, 0);
+        break;
+    case POLICY_RANDOM:
+        state.randomState = seed != 0 ? seed : 1;
+        break;
+    case POLICY_SRRIP:
+        state.rrpv.assign(numSets * ways, SRRIP_MAX_RRPV);
+        break;
+    default:
+        break;
+    }
+}
+
+// Moves way to the most recently used end of its set's LRU list.
+void lruMoveToFront(ReplacementState &state, int set, int way)
+{
+    if (state.mru[set] == way)
+    {
+        return;
+    }
+    int *newer = &state.newer[set * state.ways];
+    int *older = &state.older[set * state.ways];
+    if (newer[way] != -1)
+    {
+        // Unlink from its current position
+        if (older[way] != -1)
+            newer[older[way]] = newer[way];
+        else
+            state.lru[set] = newer[way];
+        older[newer[way]] = older[way];
+    }
+    newer[way] = -1;
+    older[way] = state.mru[set];
+    if (state.mru[set] != -1)
+        newer[state.mru[set]] = way;
+    state.mru[set] = way;
+    if (state.lru[set] == -1)
+        state.lru[set] = way;
+}
+
+// Points every node on the path to way at the other half of the tree.
+void plruTouch(ReplacementState &state, int set, int way)
+{
+    unsigned char *treeBits = &state.treeBits[set * state.treeLeaves];
+    int node = 1;
+    int low = 0;
+    int high = state.treeLeaves;
+    while (high - low > 1)
+    {
+        int mid = (low + high) / 2;
+        if (way < mid)
+        {
+            treeBits[node] = 1;
+            node = 2 * node;
+            high = mid;
+        }
+        else
+        {
+            treeBits[node] = 0;
+            node = 2 * node + 1;
+            low = mid;
+        }
+    }
+}
+
+int plruVictim(const ReplacementState &state, int set)
+{
+    const unsigned char *treeBits = &state.treeBits[set * state.treeLeaves];
+    int node = 1;
+    int low = 0;
+    int high = state.treeLeaves;
+    while (high - low > 1)
+    {
+        int mid = (low + high) / 2;
+        // Padding leaves past the real ways are never chosen
+        if (treeBits[node] == 1 && mid < state.ways)
+        {
+            node = 2 * node + 1;
+            low = mid;
+        }
+        else
+        {
+            node = 2 * node;
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Called on a hit to way.
+void replacementTouch(ReplacementState &state, int set, int way)
+{
+    switch (state.policy)
+    {
+    case POLICY_LFU:
+        state.hitCount[set * state.ways + way]++;
+        break;
+    case POLICY_LRU:
+        lruMoveToFront(state, set, way);
+        break;
+    case POLICY_PLRU:
+        plruTouch(state, set, way);
+        break;
+    case POLICY_SRRIP:
+        state.rrpv[set * state.ways + way] = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+// Called when way is filled with a new entry.
+void replacementInsert(ReplacementState &state, int set, int way)
+{
+    if (way == state.validCount[set] && state.validCount[set] < state.ways)
+    {
+        state.validCount[set]++;
+    }
+    switch (state.policy)
+    {
+    case POLICY_LFU:
+        state.hitCount[set * state.ways + way] = 0;
+        break;
+    case POLICY_LRU:
+        lruMoveToFront(state, set, way);
+        break;
+    case POLICY_PLRU:
+        plruTouch(state, set, way);
+        break;
+    case POLICY_FIFO:
+        state.fifoNext[set] = (way + 1) % state.ways;
+        break;
+    case POLICY_SRRIP:
+        state.rrpv[set * state.ways + way] = SRRIP_MAX_RRPV - 1;
+        break;
+    default:
+        break;
+    }
+}
+
+// Picks the way to fill on a miss.
+int replacementVictim(ReplacementState &state, int set)
+{
+    if (state.policy == POLICY_LFU)
+    {
+        // Kept as it always was: first way with the fewest hits, empty or not
+        const int *hitCount = &state.hitCount[set * state.ways];
+        int lruIndex = 0;
+        int minValue = POSITIVE_INFINITY;
+        for (int i = 0; i < state.ways; i++)
+        {
+            if (minValue > hitCount[i])
+            {
+                minValue = hitCount[i];
+                lruIndex = i;
+            }
+        }
+        return lruIndex;
+    }
+    if (state.validCount[set] < state.ways)
+    {
+        return state.validCount[set];
+    }
+    switch (state.policy)
+    {
+    case POLICY_LRU:
+        return state.lru[set];
+    case POLICY_PLRU:
+        return plruVictim(state, set);
+    case POLICY_FIFO:
+        return state.fifoNext[set];
+    case POLICY_RANDOM:
+        // xorshift32
+        state.randomState ^= state.randomState << 13;
+        state.randomState ^= state.randomState >> 17;
+        state.randomState ^= state.randomState << 5;
+        return state.randomState % state.ways;
+    case POLICY_SRRIP:
+    {
+        unsigned char *rrpv = &state.rrpv[set * state.ways];
+        while (true)
+        {
+            for (int i = 0; i < state.ways; i++)
+            {
+                if (rrpv[i] == SRRIP_MAX_RRPV)
+                    return i;
+            }
+            for (int i = 0; i < state.ways; i++)
+            {
+                rrpv[i]++;
+            }
+        }
+    }
+    default:
+        return 0;
+    }
+}
+
+ReplacementPolicy parseReplacementPolicy(const string &value)
+{
+    if (value == "lru")
+        return POLICY_LRU;
+    if (value == "plru")
+        return POLICY_PLRU;
+    if (value == "fifo")
+        return POLICY_FIFO;
+    if (value == "random")
+        return POLICY_RANDOM;
+    if (value == "srrip")
+        return POLICY_SRRIP;
+    if (value != "lfu")
+        cerr << "Error: Unknown replacement policy " << value << ", using lfu." << endl;
+    return POLICY_LFU;
+}
+
+const char *replacementPolicyName(ReplacementPolicy policy)
+{
+    switch (policy)
+    {
+    case POLICY_LRU:
+        return "lru";
+    case POLICY_PLRU:
+        return "plru";
+    case POLICY_FIFO:
+        return "fifo";
+    case POLICY_RANDOM:
+        return "random";
+    case POLICY_SRRIP:
+        return "srrip";
+    default:
+        return "lfu";
+    }
+}
+
+PrefetcherType parsePrefetcher(const string &value)
+{
+    if (value == "next-line")
+        return PREFETCH_NEXT_LINE;
+    if (value == "stride")
+        return PREFETCH_STRIDE;
+    if (value == "stream")
+        return PREFETCH_STREAM;
+    if (value != "none")
+        cerr << "Error: Unknown prefetcher " << value << ", using none." << endl;
+    return PREFETCH_NONE;
+}
+
+const char *prefetcherName(PrefetcherType type)
+{
+    switch (type)
+    {
+    case PREFETCH_NEXT_LINE:
+        return "next-line";
+    case PREFETCH_STRIDE:
+        return "stride";
+    case PREFETCH_STREAM:
+        return "stream";
+    default:
+        return "none";
+    }
+}
+
+void initPrefetcher(Prefetcher &prefetcher, PrefetcherType type, int degree, int cacheLines, int pageShift)
+{
+    prefetcher = Prefetcher();
+    prefetcher.type = type;
+    prefetcher.degree = max(degree, 1);
+    prefetcher.pageShift = pageShift;
+    if (type == PREFETCH_NONE)
+    {
+        return;
+    }
+    prefetcher.readyCycle.assign(cacheLines, 0);
+    if (type == PREFETCH_STRIDE)
+    {
+        prefetcher.strideTable.assign(PREFETCH_STRIDE_ENTRIES, StrideEntry());
+    }
+    if (type == PREFETCH_STREAM)
+    {
+        prefetcher.streams.assign(PREFETCH_STREAMS, StreamEntry());
+    }
+}
+
+// Candidates past either end of the address space wrap around and are then dropped by
+// prefetchInPage along with the ones in other pages.
+void prefetchCandidates(Prefetcher &prefetcher, uint64_t address, int lineSize, bool trigger, vector<uint64_t> &candidates)
+{
+    int64_t line = static_cast<int64_t>(address / lineSize);
+    switch (prefetcher.type)
+    {
+    case PREFETCH_NEXT_LINE:
+        if (trigger)
+        {
+            for (int k = 1; k <= prefetcher.degree; k++)
+            {
+                candidates.push_back(static_cast<uint64_t>(line + k) * lineSize);
+            }
+        }
+        break;
+    case PREFETCH_STRIDE:
+    {
+        int64_t page = static_cast<int64_t>(address >> prefetcher.pageShift);
+        StrideEntry &entry = prefetcher.strideTable[page % PREFETCH_STRIDE_ENTRIES];
+        if (entry.page != page)
+        {
+            entry = StrideEntry();
+            entry.page = page;
+            entry.lastAddress = address;
+            break;
+        }
+        int64_t stride = static_cast<int64_t>(address - entry.lastAddress);
+        entry.lastAddress = address;
+        if (stride == 0)
+        {
+            break;
+        }
+        if (stride == entry.stride)
+        {
+            entry.confidence = min(entry.confidence + 1, 3);
+        }
+        else
+        {
+            entry.stride = stride;
+            entry.confidence = 0;
+        }
+        // Prefetch once the same stride has been seen twice in a row
+        if (entry.confidence >= 1)
+        {
+            // Strides shorter than a line step a line at a time in their direction
+            int64_t step = llabs(stride) >= lineSize ? stride : (stride > 0 ? lineSize : -lineSize);
+            for (int k = 1; k <= prefetcher.degree; k++)
+            {
+                candidates.push_back((address + k * step) / lineSize * lineSize);
+            }
+        }
+        break;
+    }
+    case PREFETCH_STREAM:
+    {
+        if (!trigger)
+        {
+            break;
+        }
+        StreamEntry *stream = nullptr;
+        for (StreamEntry &entry : prefetcher.streams)
+        {
+            if (entry.valid && entry.lastLine != line && llabs(line - entry.lastLine) <= PREFETCH_STREAM_WINDOW)
+            {
+                stream = &entry;
+                break;
+            }
+        }
+        if (stream == nullptr)
+        {
+            StreamEntry &entry = prefetcher.streams[prefetcher.nextStream];
+            prefetcher.nextStream = (prefetcher.nextStream + 1) % PREFETCH_STREAMS;
+            entry = StreamEntry();
+            entry.valid = true;
+            entry.lastLine = line;
+            break;
+        }
+        int direction = line > stream->lastLine ? 1 : -1;
+        if (direction == stream->direction)
+        {
+            stream->confidence = min(stream->confidence + 1, 3);
+        }
+        else
+        {
+            stream->direction = direction;
+            stream->confidence = 0;
+        }
+        stream->lastLine = line;
+        if (stream->confidence >= 1)
+        {
+            for (int k = 1; k <= prefetcher.degree; k++)
+            {
+                candidates.push_back(static_cast<uint64_t>(line + direction * k) * lineSize);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void initPageIndex(PageIndex &index, int maxEntries)
+{
+    // Keep the load factor at or below one half
+    int bits = 1;
+    while ((1 << bits) < 2 * maxEntries)
+    {
+        bits++;
+    }
+    index.virtualPages.assign(1 << bits, 0);
+    index.frames.assign(1 << bits, -1);
+    index.mask = (1u << bits) - 1;
+    index.hashShift = MAX_BITS - bits;
+}
+
+unsigned int pageIndexSlot(const PageIndex &index, uint64_t virtualPage)
+{
+    // Fibonacci hashing spreads the sequential page numbers traces tend to use
+    return static_cast<unsigned int>((virtualPage * 0x9e3779b97f4a7c15ull) >> index.hashShift) & index.mask;
+}
+
+int pageIndexFind(const PageIndex &index, uint64_t virtualPage)
+{
+    for (unsigned int slot = pageIndexSlot(index, virtualPage);; slot = (slot + 1) & index.mask)
+    {
+        if (index.frames[slot] == -1)
+            return -1;
+        if (index.virtualPages[slot] == virtualPage)
+            return index.frames[slot];
+    }
+}
+
+void pageIndexInsert(PageIndex &index, uint64_t virtualPage, int frame)
+{
+    unsigned int slot = pageIndexSlot(index, virtualPage);
+    while (index.frames[slot] != -1 && index.virtualPages[slot] != virtualPage)
+    {
+        slot = (slot + 1) & index.mask;
+    }
+    index.virtualPages[slot] = virtualPage;
+    index.frames[slot] = frame;
+}
+
+// Removes virtualPage, shifting later entries of its probe run back so no tombstones are needed.
+void pageIndexErase(PageIndex &index, uint64_t virtualPage)
+{
+    unsigned int slot = pageIndexSlot(index, virtualPage);
+    while (index.frames[slot] != -1 && index.virtualPages[slot] != virtualPage)
+    {
+        slot = (slot + 1) & index.mask;
+    }
+    if (index.frames[slot] == -1)
+        return;
+
+    unsigned int hole = slot;
+    for (unsigned int next = (hole + 1) & index.mask; index.frames[next] != -1; next = (next + 1) & index.mask)
+    {
+        unsigned int home = pageIndexSlot(index, index.virtualPages[next]);
+        // Move the entry into the hole unless its home slot lies cyclically in (hole, next]
+        if (((next - home) & index.mask) >= ((next - hole) & index.mask))
+        {
+            index.virtualPages[hole] = index.virtualPages[next];
+            index.frames[hole] = index.frames[next];
+            hole = next;
+        }
+    }
+    index.frames[hole] = -1;
+}
+
+void Simulator::calculateBits()
+{
+    pageOffSetBits = log2(config.ptConfig.pageSize);
+    indexBits = log2(config.dtlbConfig.numSets);
+    double physicalBytes = static_cast<double>(config.ptConfig.numPhysicalPages) * config.ptConfig.pageSize;
+    if (config.ptConfig.levels > 0)
+    {
+        // Virtual addresses span every level of the radix page table
+        walkLevelBits = log2(config.ptConfig.pageSize / PTE_BYTES);
+        totalBits = pageOffSetBits + config.ptConfig.levels * walkLevelBits;
+    }
+    else
+    {
+        walkLevelBits = 0;
+        totalBits = log2(physicalBytes * config.ptConfig.numVirtualPages); // virtual
+    }
+    tagBits = totalBits - pageOffSetBits - indexBits;
+    VPNBits = tagBits + indexBits;
+    physicalPageBits = log2(config.ptConfig.numVirtualPages);
+
+    // DC
+    dcIndexBits = log2(config.dcConfig.numSets);
+    dcOffsetBits = log2(config.dcConfig.lineSize);
+    // The radix page table lives in a region as large as memory above it
+    pageTableBase = static_cast<uint64_t>(physicalBytes);
+    int physicalBits = static_cast<int>(log2(physicalBytes)) + (config.ptConfig.levels > 0 ? 1 : 0);
+    // Each huge page pool follows, aligned to its page size
+    uint64_t physicalEnd = static_cast<uint64_t>(physicalBytes) * (config.ptConfig.levels > 0 ? 2 : 1);
+    uint64_t hugeStart = physicalEnd;
+    hugeFrames.assign(HUGE_PAGE_SIZES, HugePageFrames());
+    for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+    {
+        const HugePageConfig &hugePages = config.ptConfig.hugePages[size - 1];
+        if (hugePages.numPages > 0)
+        {
+            uint64_t bytes = pageSizeBytes(config.ptConfig, size);
+            uint64_t start = (physicalEnd + bytes - 1) / bytes * bytes;
+            hugeFrames[size - 1].firstPage = static_cast<int>(start >> pageOffSetBits);
+            hugeFrames[size - 1].basePages = static_cast<int>(bytes >> pageOffSetBits);
+            physicalEnd = start + bytes * hugePages.numPages;
+        }
+        hugeTLBIndexBits[size - 1] = hugePages.tlbSets > 0 ? static_cast<int>(log2(hugePages.tlbSets)) : 0;
+    }
+    while (physicalEnd > hugeStart && physicalBits < MAX_BITS - 1 && (1ull << physicalBits) < physicalEnd)
+    {
+        physicalBits++;
+    }
+    dcTotalBits = physicalBits;
+    dcTagBits = dcTotalBits - dcIndexBits - dcOffsetBits;
+    // cout<<"dcOffsetBits: "<<dcOffsetBits<<endl;
+    // cout<<"dcIndexBits :"<<dcIndexBits<<endl;
+    // cout<<"dcTagBits: "<<dcTagBits<<endl;
+    // cout<<"dcTotalBits :"<<dcTotalBits<<endl;
+
+    // L2
+    l2IndexBits = log2(config.l2Config.numSets);
+    l2OffsetBits = log2(config.l2Config.lineSize);
+    l2TotalBits = physicalBits;
+    l2TagBits = l2TotalBits - l2IndexBits - l2OffsetBits;
+    // cout<<"l2OffsetBits: "<<dec<<l2OffsetBits<<endl;
+    // cout<<"l2IndexBits :"<<l2IndexBits<<endl;
+    // cout<<"l2TagBits: "<<l2TagBits<<endl;
+    // cout<<"l2TotalBits :"<<l2TotalBits<<endl;
+
+    // Address decoder
+    layout.virtualPage = makeBitField(0, VPNBits, totalBits);
+    layout.pageOffset = makeBitField(tagBits + indexBits, tagBits + indexBits + pageOffSetBits, totalBits);
+    layout.tlbTag = makeBitField(0, tagBits, totalBits);
+    layout.tlbIndex = makeBitField(tagBits, tagBits + indexBits, totalBits);
+    layout.dcTag = makeBitField(0, dcTagBits, dcTotalBits);
+    layout.dcIndex = makeBitField(dcTagBits, dcTagBits + dcIndexBits, dcTotalBits);
+    layout.l2Tag = makeBitField(0, l2TagBits, l2TotalBits);
+    layout.l2Index = makeBitField(l2TagBits, l2TagBits + l2IndexBits, l2TotalBits);
+    layout.pageOffsetBits = pageOffSetBits;
+}
+
+// Bytes in a page of pageSize: the base page size for 0, otherwise the span of an entry
+// that many levels above the last level of the radix page table.
+uint64_t pageSizeBytes(const MemoryConfig &config, int pageSize)
+{
+    int levelBits = static_cast<int>(log2(max(config.pageSize, 1))) - static_cast<int>(log2(PTE_BYTES));
+    return static_cast<uint64_t>(config.pageSize) << (levelBits * pageSize);
+}
+
+// The largest binary unit that divides bytes evenly, e.g. 4K, 2M or 1G.
+string byteSizeLabel(uint64_t bytes)
+{
+    const char *units = "KMGTP";
+    int unit = -1;
+    while (unit < 4 && bytes >= 1024 && bytes % 1024 == 0)
+    {
+        bytes /= 1024;
+        unit++;
+    }
+    return to_string(bytes) + (unit >= 0 ? string(1, units[unit]) : string());
+}
+
+// A count of bytes with an optional K, M or G suffix, as in "2M".
+bool parseByteSize(const string &text, uint64_t &bytes)
+{
+    char *end = nullptr;
+    bytes = strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str())
+    {
+        return false;
+    }
+    string suffix = end;
+    if (suffix == "K")
+        bytes <<= 10;
+    else if (suffix == "M")
+        bytes <<= 20;
+    else if (suffix == "G")
+        bytes <<= 30;
+    else if (!suffix.empty())
+        return false;
+    return bytes > 0;
+}
+
+// Huge page settings named by their size, e.g. "2M sets", until the page size and
+// levels they resolve against are known.
+struct ParsedHugePages
+{
+    uint64_t pageBytes;
+    HugePageConfig pages;
+};
+
+struct ParsedHugePageRegion
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t pageBytes;
+};
+
+HugePageConfig &parsedHugePages(vector<ParsedHugePages> &parsed, uint64_t pageBytes)
+{
+    for (ParsedHugePages &entry : parsed)
+    {
+        if (entry.pageBytes == pageBytes)
+        {
+            return entry.pages;
+        }
+    }
+    parsed.push_back({pageBytes, HugePageConfig()});
+    return parsed.back().pages;
+}
+
+// "start-end size" with the addresses in hex and end exclusive, e.g.
+// "7f0000000000-7f0040000000 2M".
+bool parseHugePageRegion(const string &value, ParsedHugePageRegion &region)
+{
+    istringstream iss(value);
+    string range, size;
+    iss >> range >> size;
+    size_t dash = range.find('-');
+    if (dash == string::npos || !parseByteSize(size, region.pageBytes))
+    {
+        return false;
+    }
+    char *end = nullptr;
+    region.start = strtoull(range.substr(0, dash).c_str(), &end, 16);
+    bool valid = *end == '\0' && dash > 0;
+    region.end = strtoull(range.substr(dash + 1).c_str(), &end, 16);
+    return valid && *end == '\0' && dash + 1 < range.size();
+}
+
+// Places the parsed huge page sizes and regions in config, dropping those the page
+// table cannot map with an error.
+void resolveHugePages(Configuration &config, const vector<ParsedHugePages> &parsed, const vector<ParsedHugePageRegion> &regions)
+{
+    MemoryConfig &pt = config.ptConfig;
+    if (pt.levels == 0)
+    {
+        cerr << "Error: Huge pages need a radix page table (Page table levels), ignoring them." << endl;
+        return;
+    }
+    int pageBits = static_cast<int>(log2(pt.pageSize));
+    int levelBits = pageBits - static_cast<int>(log2(PTE_BYTES));
+    for (const ParsedHugePages &entry : parsed)
+    {
+        int size = 0;
+        for (int candidate = 1; candidate <= HUGE_PAGE_SIZES && candidate < pt.levels; candidate++)
+        {
+            if (pageSizeBytes(pt, candidate) == entry.pageBytes)
+            {
+                size = candidate;
+            }
+        }
+        string label = byteSizeLabel(entry.pageBytes);
+        if (size == 0)
+        {
+            cerr << "Error: A " << pt.levels << "-level page table of " << pt.pageSize << " byte pages has no " << label
+                 << " pages, ignoring them." << endl;
+        }
+        else if (entry.pages.numPages <= 0 || (static_cast<uint64_t>(entry.pages.numPages) << (levelBits * size)) > static_cast<uint64_t>(POSITIVE_INFINITY / 4))
+        {
+            cerr << "Error: The number of " << label << " pages must be positive and their base pages fit an int, ignoring them." << endl;
+        }
+        else
+        {
+            pt.hugePages[size - 1] = entry.pages;
+            if (entry.pages.tlbSetSize <= 0)
+            {
+                pt.hugePages[size - 1].tlbSets = 0;
+            }
+        }
+    }
+    for (const ParsedHugePageRegion &parsedRegion : regions)
+    {
+        HugePageRegion region = {parsedRegion.start, parsedRegion.end, 0};
+        for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+        {
+            if (pt.hugePages[size - 1].numPages > 0 && pageSizeBytes(pt, size) == parsedRegion.pageBytes)
+            {
+                region.pageSize = size;
+            }
+        }
+        bool overlaps = false;
+        for (const HugePageRegion &other : pt.hugePageRegions)
+        {
+            overlaps |= region.start < other.end && other.start < region.end;
+        }
+        uint64_t alignment = parsedRegion.pageBytes - 1;
+        if (region.pageSize == 0 || region.start >= region.end || (region.start & alignment) != 0 || (region.end & alignment) != 0 || overlaps)
+        {
+            cerr << "Error: Huge page region " << hex << region.start << "-" << region.end << dec << " of "
+                 << byteSizeLabel(parsedRegion.pageBytes)
+                 << " pages must be aligned, must not overlap another, and needs pages of its size, ignoring it." << endl;
+            continue;
+        }
+        pt.hugePageRegions.push_back(region);
+    }
+}
+
+Configuration readConfigFile(const string &filename)
+{
+    ifstream file(filename);
+    Configuration config;
+    string line;
+    string currentData;
+    vector<ParsedHugePages> hugePages;
+    vector<ParsedHugePageRegion> hugePageRegions;
+    if (file.is_open())
+    {
+
+        while (getline(file, line))
+        {
+            if (line.find(':') != string::npos)
+            {
+                istringstream iss(line);
+                string key, value;
+                getline(iss, key, ':');
+                getline(iss, value);
+
+                uint64_t pageBytes;
+                key.erase(0, key.find_first_not_of(" \t"));
+                key.erase(key.find_last_not_of(" \t") + 1);
+                value.erase(0, value.find_first_not_of(" \t"));
+                value.erase(value.find_last_not_of(" \t") + 1);
+
+                // These follow the L2 section without a heading of their own
+                if (key == "Virtual addresses")
+                {
+                    config.useVirtualAddresses = (value == "y");
+                }
+                else if (key == "TLB")
+                {
+                    config.useTLB = (value == "y");
+                }
+                else if (key == "L2 cache")
+                {
+                    config.useL2Cache = (value == "y");
+                }
+                else if (key == "Number of cores")
+                {
+                    config.numCores = max(stoi(value), 1);
+                }
+                else if (currentData.find("Data TLB configuration") != string::npos)
+                {
+                    if (key == "Number of sets")
+                    {
+                        config.dtlbConfig.numSets = stoi(value);
+                    }
+                    else if (key == "Set size")
+                    {
+                        config.dtlbConfig.setSize = stoi(value);
+                    }
+                    else if (key == "Replacement policy")
+                    {
+                        config.dtlbConfig.policy = parseReplacementPolicy(value);
+                    }
+                    else if (key.size() > 9 && key.compare(key.size() - 9, 9, " set size") == 0 &&
+                             parseByteSize(key.substr(0, key.size() - 9), pageBytes))
+                    {
+                        parsedHugePages(hugePages, pageBytes).tlbSetSize = stoi(value);
+                    }
+                    else if (key.size() > 5 && key.compare(key.size() - 5, 5, " sets") == 0 &&
+                             parseByteSize(key.substr(0, key.size() - 5), pageBytes))
+                    {
+                        parsedHugePages(hugePages, pageBytes).tlbSets = stoi(value);
+                    }
+                }
+                else if (currentData.find("Page Table configuration") != string::npos)
+                {
+                    if (key == "Number of virtual pages")
+                    {
+                        config.ptConfig.numVirtualPages = stoi(value);
+                    }
+                    else if (key == "Number of physical pages")
+                    {
+                        config.ptConfig.numPhysicalPages = stoi(value);
+                    }
+                    else if (key == "Page size")
+                    {
+                        config.ptConfig.pageSize = stoi(value);
+                    }
+                    else if (key == "Replacement policy")
+                    {
+                        config.ptConfig.policy = parseReplacementPolicy(value);
+                    }
+                    else if (key == "Page table levels")
+                    {
+                        config.ptConfig.levels = stoi(value);
+                    }
+                    else if (key == "Page walk cache entries")
+                    {
+                        config.ptConfig.walkCacheEntries = max(stoi(value), 0);
+                    }
+                    else if (key == "Huge page region")
+                    {
+                        ParsedHugePageRegion region;
+                        if (parseHugePageRegion(value, region))
+                        {
+                            hugePageRegions.push_back(region);
+                        }
+                        else
+                        {
+                            cerr << "Error: Unable to read huge page region " << value << "." << endl;
+                        }
+                    }
+                    else if (key.size() > 16 && key.compare(0, 10, "Number of ") == 0 && key.compare(key.size() - 6, 6, " pages") == 0 &&
+                             parseByteSize(key.substr(10, key.size() - 16), pageBytes))
+                    {
+                        parsedHugePages(hugePages, pageBytes).numPages = stoi(value);
+                    }
+                }
+                else if (currentData.find("Data Cache configuration") != string::npos)
+                {
+                    if (key == "Number of sets")
+                    {
+                        config.dcConfig.numSets = stoi(value);
+                    }
+                    else if (key == "Set size")
+                    {
+                        config.dcConfig.setSize = stoi(value);
+                    }
+                    else if (key == "Line size")
+                    {
+                        config.dcConfig.lineSize = stoi(value);
+                    }
+                    else if (key == "Write through/no write allocate")
+                    {
+                        config.dcConfig.writeThroughOrNoWriteAllocate = (value == "y");
+                    }
+                    else if (key == "Replacement policy")
+                    {
+                        config.dcConfig.policy = parseReplacementPolicy(value);
+                    }
+                    else if (key == "Prefetcher")
+                    {
+                        config.dcConfig.prefetcher = parsePrefetcher(value);
+                    }
+                    else if (key == "Prefetch degree")
+                    {
+                        config.dcConfig.prefetchDegree = max(stoi(value), 1);
+                    }
+                }
+                else if (currentData.find("Timing configuration") != string::npos)
+                {
+                    if (key == "TLB latency")
+                    {
+                        config.timing.tlbLatency = stoi(value);
+                    }
+                    else if (key == "Page walk latency")
+                    {
+                        config.timing.pageWalkLatency = stoi(value);
+                    }
+                    else if (key == "DC latency")
+                    {
+                        config.timing.dcLatency = stoi(value);
+                    }
+                    else if (key == "L2 latency")
+                    {
+                        config.timing.l2Latency = stoi(value);
+                    }
+                    else if (key == "Memory latency")
+                    {
+                        config.timing.memoryLatency = stoi(value);
+                    }
+                    else if (key == "Disk latency")
+                    {
+                        config.timing.diskLatency = stoi(value);
+                    }
+                }
+                else if (currentData.find("L2 Cache configuration") != string::npos)
+                {
+                    if (key == "Number of sets")
+                    {
+                        config.l2Config.numSets = stoi(value);
+                    }
+                    else if (key == "Set size")
+                    {
+                        config.l2Config.setSize = stoi(value);
+                    }
+                    else if (key == "Line size")
+                    {
+                        config.l2Config.lineSize = stoi(value);
+                    }
+                    else if (key == "Replacement policy")
+                    {
+                        config.l2Config.policy = parseReplacementPolicy(value);
+                    }
+                    else if (key == "Prefetcher")
+                    {
+                        config.l2Config.prefetcher = parsePrefetcher(value);
+                    }
+                    else if (key == "Prefetch degree")
+                    {
+                        config.l2Config.prefetchDegree = max(stoi(value), 1);
+                    }
+                }
+            }
+            else if (line.size() > 0)
+            {
+                currentData = line;
+            }
+        }
+
+        file.close();
+    }
+    else
+    {
+        cerr << "Error: Unable to open trace file." << endl;
+    }
+    if (config.ptConfig.levels != 0)
+    {
+        // Each level needs at least one index bit, and the virtual address must fit in 64 bits
+        int pageBits = static_cast<int>(log2(max(config.ptConfig.pageSize, 1)));
+        int levelBits = pageBits - static_cast<int>(log2(PTE_BYTES));
+        if (config.ptConfig.levels < 0 || config.ptConfig.levels > MAX_PAGE_TABLE_LEVELS || levelBits < 1 ||
+            pageBits + config.ptConfig.levels * levelBits > MAX_BITS - 1)
+        {
+            cerr << "Error: A page table of " << config.ptConfig.levels << " levels with " << config.ptConfig.pageSize
+                 << " byte pages is not supported, using the flat page table." << endl;
+            config.ptConfig.levels = 0;
+        }
+    }
+    if (!hugePages.empty() || !hugePageRegions.empty())
+    {
+        resolveHugePages(config, hugePages, hugePageRegions);
+    }
+    return config;
+}
+
+void printDataTLBConfig(const DataTLBConfig &tlbConfig)
+{
+    cout << "Number of Sets: " << tlbConfig.numSets << endl;
+    cout << "Set Size: " << tlbConfig.setSize << endl;
+    cout << "Replacement Policy: " << replacementPolicyName(tlbConfig.policy) << endl;
+}
+
+void printDataCacheConfig(const DataCacheConfig &cacheConfig)
+{
+    cout << "Number of Sets: " << cacheConfig.numSets << endl;
+    cout << "Set Size: " << cacheConfig.setSize << endl;
+    cout << "Line Size: " << cacheConfig.lineSize << endl;
+    cout << "write Through Or No Write Allocate: " << (cacheConfig.writeThroughOrNoWriteAllocate ? "yes" : "no") << endl;
+    cout << "Replacement Policy: " << replacementPolicyName(cacheConfig.policy) << endl;
+    if (cacheConfig.prefetcher != PREFETCH_NONE)
+    {
+        cout << "Prefetcher: " << prefetcherName(cacheConfig.prefetcher) << " (degree " << cacheConfig.prefetchDegree << ")" << endl;
+    }
+}
+
+void printL2CacheConfig(const L2CacheConfig &cacheConfig)
+{
+    cout << "Number of Sets: " << cacheConfig.numSets << endl;
+    cout << "Set Size: " << cacheConfig.setSize << endl;
+    cout << "Line Size: " << cacheConfig.lineSize << endl;
+    cout << "Replacement Policy: " << replacementPolicyName(cacheConfig.policy) << endl;
+    if (cacheConfig.prefetcher != PREFETCH_NONE)
+    {
+        cout << "Prefetcher: " << prefetcherName(cacheConfig.prefetcher) << " (degree " << cacheConfig.prefetchDegree << ")" << endl;
+    }
+}
+
+void printMemoryConfig(const MemoryConfig &memoryConfig)
+{
+    cout << "Number of Virtual Pages: " << memoryConfig.numVirtualPages << endl;
+    cout << "Number of Physical Pages: " << memoryConfig.numPhysicalPages << endl;
+    cout << "Page Size: " << memoryConfig.pageSize << endl;
+    cout << "Replacement Policy: " << replacementPolicyName(memoryConfig.policy) << endl;
+    if (memoryConfig.levels > 0)
+    {
+        cout << "Page Table Levels: " << memoryConfig.levels << endl;
+        cout << "Page Walk Cache Entries: " << memoryConfig.walkCacheEntries << endl;
+    }
+    for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+    {
+        const HugePageConfig &hugePages = memoryConfig.hugePages[size - 1];
+        if (hugePages.numPages > 0)
+        {
+            cout << "Huge Pages " << byteSizeLabel(pageSizeBytes(memoryConfig, size)) << ": " << hugePages.numPages
+                 << " (TLB " << hugePages.tlbSets << " sets of " << hugePages.tlbSetSize << ")" << endl;
+        }
+    }
+    for (const HugePageRegion &region : memoryConfig.hugePageRegions)
+    {
+        cout << "Huge Page Region: " << hex << region.start << "-" << region.end << dec << " "
+             << byteSizeLabel(pageSizeBytes(memoryConfig, region.pageSize)) << endl;
+    }
+}
+
+void Simulator::printConfiguration() const
+{
+    cout << "Data TLB configuration:" << endl;
+    printDataTLBConfig(config.dtlbConfig);
+
+    cout << "Page Table configuration:" << endl;
+    printMemoryConfig(config.ptConfig);
+
+    cout << "Data Cache configuration:" << endl;
+    printDataCacheConfig(config.dcConfig);
+
+    cout << "L2 Cache configuration:" << endl;
+    printL2CacheConfig(config.l2Config);
+
+    cout << "Addresses: " << (config.useVirtualAddresses ? "virtual" : "physical") << endl;
+    cout << "TLB: " << (config.useTLB ? "yes" : "no") << endl;
+    cout << "L2 Cache: " << (config.useL2Cache ? "yes" : "no") << endl;
+    if (config.numCores > 1)
+    {
+        cout << "Cores: " << config.numCores << endl;
+    }
+}
+
+// The TLB and DC dumps show core 0.
+void Simulator::printDTLB()
+{
+    CacheLevel<int, 0, int64_t> &dtlb = cores[0].dtlb;
+    cout << "DTLB Data" << endl;
+    for (int set = 0; set < dtlb.numSets; set++)
+    {
+        cout << "Set: " << set << endl;
+        for (int way = 0; way < dtlb.ways; way++)
+        {
+            cout << " inex: " << way << " VPN: " << hex << ((dtlb.tagAt(set, way) << indexBits) | set) << " PP: "
+                 << " " << dtlb.entry(set, way) << endl;
+        }
+    }
+}
+
+void Simulator::printPageTable() const
+{
+    cout << "Page Table Data" << endl;
+    for (Page page : pageTableList)
+    {
+        cout << " physicalPage: " << page.physicalPage << " VPN: " << page.virtualPage << endl;
+    }
+}
+
+void Simulator::printDC() const
+{
+    const CacheLevel<DCLineState> &dataCache = cores[0].dataCache;
+    cout << endl
+         << "DC DATA" << endl;
+    for (int set = 0; set < dataCache.numSets; set++)
+    {
+        cout << "set : " << set << endl;
+        for (int way = 0; way < dataCache.ways; way++)
+        {
+            cout << " dc: " << way << " tag: " << dataCache.tagAt(set, way) << endl;
+        }
+    }
+}
+
+void Simulator::printSimulationStatistics(ostream &out)
+{
+    dtlbHitRatio = (dtlbHits + dtlbMisses) > 0 ? static_cast<double>(dtlbHits) / (dtlbHits + dtlbMisses) : 0;
+    ptHitRatio = (ptHits + ptFaults) > 0 ? static_cast<double>(ptHits) / (ptHits + ptFaults) : 0;
+    dcHitRatio = (dcHits + dcMisses) > 0 ? static_cast<double>(dcHits) / (dcHits + dcMisses) : 0;
+    l2HitRatio = (l2Hits + l2Misses) > 0 ? static_cast<double>(l2Hits) / (l2Hits + l2Misses) : 0;
+    ratioOfReads = (totalReads + totalWrites) > 0 ? static_cast<double>(totalReads) / (totalReads + totalWrites) : 0;
+
+    // cout << endl<< "Simulation statistics" << endl<<endl;
+    // cout << "dtlb hits : " << dtlbHits << endl;
+    // cout << "dtlb misses : " << dtlbMisses << endl;
+    // cout << "dtlb hit ratio : " << fixed << setprecision(6) << dtlbHitRatio << endl<< endl;
+    // cout << "pt hits : " << ptHits << endl;
+    // cout << "pt faults : " << ptFaults << endl;
+    // cout << "pt hit ratio : " << fixed << setprecision(6) << ptHitRatio << endl<< endl;
+    // cout << "dc hits : " << dcHits << endl;
+    // cout << "dc misses : " << dcMisses << endl;
+    // cout << "dc hit ratio : " << fixed << setprecision(6) << dcHitRatio << endl<< endl;
+    // cout << "L2 hits : " << l2Hits << endl;
+    // cout << "L2 misses : " << l2Misses << endl;
+    // cout << "L2 hit ratio : " << fixed << setprecision(6) << l2HitRatio << endl<< endl;
+    // cout << "Total reads : " << totalReads << endl;
+    // cout << "Total writes : " << totalWrites << endl;
+    // cout << "Ratio of reads : " << fixed << setprecision(6) << ratioOfReads << endl<< endl;
+    // cout << "main memory refs : " << mainMemoryRefs << endl;
+    // cout << "page table refs : " << pageTableRefs << endl;
+    // cout << "disk refs : " << diskRefs << endl;
+
+    out << endl
+         << "Simulation statistics" << endl
+         << endl;
+    out << left << setw(17) << "dtlb hits"
+         << ": " << dtlbHits << endl;
+    out << left << setw(17) << "dtlb misses"
+         << ": " << dtlbMisses << endl;
+    out << left << setw(17) << "dtlb hit ratio"
+         << ": " << fixed << setprecision(6) << dtlbHitRatio << endl
+         << endl;
+    out << left << setw(17) << "pt hits"
+         << ": " << ptHits << endl;
+    out << left << setw(17) << "pt faults"
+         << ": " << ptFaults << endl;
+    out << left << setw(17) << "pt hit ratio"
+         << ": " << fixed << setprecision(6) << ptHitRatio << endl
+         << endl;
+    out << left << setw(17) << "dc hits"
+         << ": " << dcHits << endl;
+    out << left << setw(17) << "dc misses"
+         << ": " << dcMisses << endl;
+    out << left << setw(17) << "dc hit ratio"
+         << ": " << fixed << setprecision(6) << dcHitRatio << endl
+         << endl;
+    out << left << setw(17) << "L2 hits"
+         << ": " << l2Hits << endl;
+    out << left << setw(17) << "L2 misses"
+         << ": " << l2Misses << endl;
+    out << left << setw(17) << "L2 hit ratio"
+         << ": " << fixed << setprecision(6) << l2HitRatio << endl
+         << endl;
+    out << left << setw(17) << "Total reads"
+         << ": " << totalReads << endl;
+    out << left << setw(17) << "Total writes"
+         << ": " << totalWrites << endl;
+    out << left << setw(17) << "Ratio of reads"
+         << ": " << fixed << setprecision(6) << ratioOfReads << endl
+         << endl;
+    out << left << setw(17) << "main memory refs"
+         << ": " << mainMemoryRefs << endl;
+    out << left << setw(17) << "page table refs"
+         << ": " << pageTableRefs << endl;
+    out << left << setw(17) << "disk refs"
+         << ": " << diskRefs << endl;
+    out << left << setw(17) << "dc write-backs"
+         << ": " << dcWriteBacks << endl;
+    out << left << setw(17) << "L2 write-backs"
+         << ": " << l2WriteBacks << endl
+         << endl;
+
+    // Timing model and the bytes moved between levels
+    SimulationStats totals = stats();
+    const struct
+    {
+        const char *label;
+        uint64_t value;
+    } timingRows[] = {
+        {"TLB cycles", totals.tlbCycles},
+        {"page walk cycles", totals.pageWalkCycles},
+        {"disk cycles", totals.diskCycles},
+        {"dc cycles", totals.dcCycles},
+        {"L2 cycles", totals.l2Cycles},
+        {"memory cycles", totals.memoryCycles},
+        {"total cycles", totals.totalCycles},
+    };
+    for (const auto &row : timingRows)
+    {
+        out << left << setw(17) << row.label << ": " << row.value << endl;
+    }
+    out << left << setw(17) << "AMAT (cycles)"
+         << ": " << fixed << setprecision(6) << totals.amat << endl
+         << endl;
+    const struct
+    {
+        const char *label;
+        uint64_t value;
+    } trafficRows[] = {
+        {"dc fill bytes", totals.dcFillBytes},
+        {"dc write bytes", totals.dcWriteBytes},
+        {"L2 fill bytes", totals.l2FillBytes},
+        {"L2 write bytes", totals.l2WriteBytes},
+        {"page-in bytes", totals.pageInBytes},
+    };
+    for (const auto &row : trafficRows)
+    {
+        out << left << setw(17) << row.label << ": " << row.value << endl;
+    }
+    out << left << setw(17) << "mem bytes/cycle"
+         << ": " << fixed << setprecision(6) << totals.memoryBandwidth << endl;
+
+    if (config.dcConfig.prefetcher != PREFETCH_NONE || config.l2Config.prefetcher != PREFETCH_NONE)
+    {
+        printPrefetchStatistics(out);
+    }
+    if (config.ptConfig.levels > 0)
+    {
+        printPageWalkStatistics(out);
+    }
+    if (!config.ptConfig.hugePageRegions.empty())
+    {
+        printPageSizeStatistics(out);
+    }
+    if (cores.size() > 1)
+    {
+        printCoherenceStatistics(out);
+    }
+}
+
+// One column per cache level; a level without a prefetcher shows zeros.
+void Simulator::printPrefetchStatistics(ostream &out) const
+{
+    SimulationStats totals = stats();
+    const int columnWidth = 12;
+    out << endl
+        << "Prefetch statistics" << endl
+        << endl;
+    out << left << setw(17) << "cache" << ":" << right << setw(columnWidth) << "dc" << setw(columnWidth) << "L2" << endl;
+    out << left << setw(17) << "prefetcher" << ":" << right << setw(columnWidth) << prefetcherName(config.dcConfig.prefetcher)
+        << setw(columnWidth) << prefetcherName(config.l2Config.prefetcher) << endl;
+    const struct
+    {
+        const char *label;
+        uint64_t PrefetchStats::*count;
+    } countRows[] = {
+        {"prefetches", &PrefetchStats::issued},
+        {"useful", &PrefetchStats::useful},
+        {"late", &PrefetchStats::late},
+        {"unused", &PrefetchStats::unused},
+        {"pollution misses", &PrefetchStats::pollutionMisses},
+    };
+    for (const auto &row : countRows)
+    {
+        out << left << setw(17) << row.label << ":" << right << setw(columnWidth) << totals.dcPrefetch.*row.count
+            << setw(columnWidth) << totals.l2Prefetch.*row.count << endl;
+    }
+    const struct
+    {
+        const char *label;
+        double PrefetchStats::*ratio;
+    } ratioRows[] = {
+        {"accuracy", &PrefetchStats::accuracy},
+        {"coverage", &PrefetchStats::coverage},
+        {"timeliness", &PrefetchStats::timeliness},
+    };
+    for (const auto &row : ratioRows)
+    {
+        out << left << setw(17) << row.label << ":" << right << fixed << setprecision(6) << setw(columnWidth)
+            << totals.dcPrefetch.*row.ratio << setw(columnWidth) << totals.l2Prefetch.*row.ratio << endl;
+    }
+}
+
+// x86-64 names of the entries of the upper page table levels, counted up from the
+// level above the page table entries.
+const char *const WALK_CACHE_NAMES[] = {"PDE", "PDPTE", "PML4E", "PML5E"};
+
+void Simulator::printPageWalkStatistics(ostream &out) const
+{
+    SimulationStats totals = stats();
+    out << endl
+        << "Page walk statistics" << endl
+        << endl;
+    const struct
+    {
+        const char *label;
+        uint64_t value;
+    } walkRows[] = {
+        {"page walks", totals.pageWalks},
+        {"walk cache hits", totals.walkCacheHits},
+        {"PTE reads", totals.pteReads},
+        {"PTE dc hits", totals.pteDCHits},
+        {"PTE L2 hits", totals.pteL2Hits},
+        {"PTE memory refs", totals.pteMemoryRefs},
+    };
+    for (const auto &row : walkRows)
+    {
+        out << left << setw(17) << row.label << ": " << row.value << endl;
+    }
+    out << left << setw(17) << "reads per walk"
+        << ": " << fixed << setprecision(6) << (totals.pageWalks > 0 ? static_cast<double>(totals.pteReads) / totals.pageWalks : 0) << endl;
+    if (walkCacheHits.empty())
+    {
+        return;
+    }
+    out << endl
+        << "walk cache  entries      hits" << endl;
+    for (size_t level = 0; level < walkCacheHits.size(); level++)
+    {
+        out << left << setw(10) << WALK_CACHE_NAMES[walkCacheHits.size() - 1 - level] << right << setw(9)
+            << config.ptConfig.walkCacheEntries << " " << setw(9) << walkCacheHits[level] << endl;
+    }
+}
+
+// One row per page size with pages: the TLB array caching its translations, the reach
+// of that array, and its TLB hits and misses and page faults.
+void Simulator::printPageSizeStatistics(ostream &out) const
+{
+    out << endl
+        << "Page size statistics" << endl
+        << endl;
+    out << "page size     pages  tlb entries     reach   tlb hits  tlb misses  tlb hit ratio    faults" << endl;
+    for (int size = 0; size <= HUGE_PAGE_SIZES; size++)
+    {
+        int pages = config.ptConfig.numPhysicalPages;
+        int entries = config.dtlbConfig.numSets * config.dtlbConfig.setSize;
+        if (size > 0)
+        {
+            const HugePageConfig &hugePages = config.ptConfig.hugePages[size - 1];
+            pages = hugePages.numPages;
+            entries = hugePages.tlbSets * hugePages.tlbSetSize;
+            if (pages == 0)
+            {
+                continue;
+            }
+        }
+        out << left << setw(9) << byteSizeLabel(pageSizeBytes(config.ptConfig, size)) << right << setw(10) << pages;
+        if (entries > 0)
+        {
+            out << setw(13) << entries << setw(10) << byteSizeLabel(entries * pageSizeBytes(config.ptConfig, size));
+        }
+        else
+        {
+            out << setw(13) << "-" << setw(10) << "-";
+        }
+        uint64_t lookups = dtlbSizeHits[size] + dtlbSizeMisses[size];
+        out << setw(11) << dtlbSizeHits[size] << setw(12) << dtlbSizeMisses[size] << fixed << setprecision(6) << setw(15)
+            << (lookups > 0 ? static_cast<double>(dtlbSizeHits[size]) / lookups : 0) << setw(10) << pageSizeFaults[size] << endl;
+    }
+    out << endl
+        << left << setw(17) << "tlb reach" << ": " << tlbReach() << " bytes per core" << endl;
+}
+
+const int FALSE_SHARING_HOT_LINES = 10;
+
+void Simulator::printCoherenceStatistics(ostream &out) const
+{
+    out << endl
+        << "Coherence statistics" << endl
+        << endl;
+    out << "core  accesses   dc hits  dc misses  coherence misses  invalidations  upgrades  false sharing" << endl;
+    for (size_t i = 0; i < cores.size(); i++)
+    {
+        const CoreState &core = cores[i];
+        out << right << setw(4) << i << " " << setw(9) << core.accesses << " " << setw(9) << core.dcHits << " "
+            << setw(10) << core.dcMisses << " " << setw(17) << core.coherenceMisses << " " << setw(14) << core.invalidations << " "
+            << setw(9) << core.upgrades << " " << setw(14) << core.falseSharing << endl;
+    }
+    out << endl
+        << "coherence write-backs: " << coherenceWriteBacks << endl;
+
+    if (falseSharingLines.empty())
+    {
+        return;
+    }
+    vector<pair<uint64_t, uint64_t> > hotLines(falseSharingLines.begin(), falseSharingLines.end());
+    sort(hotLines.begin(), hotLines.end(), [](const pair<uint64_t, uint64_t> &a, const pair<uint64_t, uint64_t> &b)
+         { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+    if (hotLines.size() > FALSE_SHARING_HOT_LINES)
+    {
+        hotLines.resize(FALSE_SHARING_HOT_LINES);
+    }
+    out << endl
+        << "False sharing hot lines" << endl
+        << endl;
+    out << "line address  misses" << endl;
+    for (const auto &line : hotLines)
+    {
+        out << right << setw(12) << hex << line.first << dec << " " << setw(7) << line.second << endl;
+    }
+}
+
+// Only non-default policies are listed so the original report layout is unchanged.
+void printReplacementPolicy(ostream &out, ReplacementPolicy policy)
+{
+    if (policy != POLICY_LFU)
+    {
+        out << "Entries are replaced using the " << replacementPolicyName(policy) << " policy." << endl;
+    }
+}
+
+void printPrefetcher(ostream &out, PrefetcherType type, int degree)
+{
+    if (type != PREFETCH_NONE)
+    {
+        out << "Lines are prefetched by a " << prefetcherName(type) << " prefetcher of degree " << degree << "." << endl;
+    }
+}
+
+void Simulator::printConfig(ostream &out) const
+{
+
+    out << "Data TLB contains " << config.dtlbConfig.numSets << " sets." << endl;
+    out << "Each set contains " << config.dtlbConfig.setSize << " entries." << endl;
+    printReplacementPolicy(out, config.dtlbConfig.policy);
+    out << "Number of bits used for the index is " << indexBits << "." << endl
+         << endl;
+
+    out << "Number of virtual pages is " << config.ptConfig.numVirtualPages << "." << endl;
+    out << "Number of physical pages is " << config.ptConfig.numPhysicalPages << "." << endl;
+    out << "Each page contains " << config.ptConfig.pageSize << " bytes." << endl;
+    printReplacementPolicy(out, config.ptConfig.policy);
+    out << "Number of bits used for the page table index is " << physicalPageBits << "." << endl;
+    out << "Number of bits used for the page offset is " << pageOffSetBits << "." << endl;
+    if (config.ptConfig.levels > 0)
+    {
+        out << "Virtual addresses are " << totalBits << " bits, translated by a " << config.ptConfig.levels
+            << "-level page table with " << walkLevelBits << " index bits per level." << endl;
+        if (config.ptConfig.walkCacheEntries > 0)
+        {
+            out << "Each core caches " << config.ptConfig.walkCacheEntries << " entries of each upper page table level." << endl;
+        }
+        for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+        {
+            const HugePageConfig &hugePages = config.ptConfig.hugePages[size - 1];
+            if (hugePages.numPages == 0)
+            {
+                continue;
+            }
+            out << "There are " << hugePages.numPages << " huge pages of " << byteSizeLabel(pageSizeBytes(config.ptConfig, size)) << ", ";
+            if (hugePages.tlbSets > 0)
+            {
+                out << "cached in a TLB of " << hugePages.tlbSets << " sets of " << hugePages.tlbSetSize << " entries." << endl;
+            }
+            else
+            {
+                out << "cached in the data TLB one " << byteSizeLabel(config.ptConfig.pageSize) << " page at a time." << endl;
+            }
+        }
+        if (!config.ptConfig.hugePageRegions.empty())
+        {
+            size_t regions = config.ptConfig.hugePageRegions.size();
+            out << "Huge pages map " << regions << (regions == 1 ? " region" : " regions") << " of virtual addresses." << endl;
+        }
+    }
+    out << endl;
+
+    out << "D-cache contains " << config.dcConfig.numSets << " sets." << endl;
+    out << "Each set contains " << config.dcConfig.setSize << " entries." << endl;
+    out << "Each line is " << config.dcConfig.lineSize << " bytes." << endl;
+    printReplacementPolicy(out, config.dcConfig.policy);
+    printPrefetcher(out, config.dcConfig.prefetcher, config.dcConfig.prefetchDegree);
+    if (config.dcConfig.writeThroughOrNoWriteAllocate == 1)
+    {
+        out << "The cache uses a no write-allocate and write-through policy." << endl;
+    }
+    out << "Number of bits used for the index is " << dcIndexBits << "." << endl;
+    out << "Number of bits used for the offset is " << dcOffsetBits << "." << endl
+         << endl;
+
+    out << "L2-cache contains " << config.l2Config.numSets << " sets." << endl;
+    out << "Each set contains " << config.l2Config.setSize << " entries." << endl;
+    out << "Each line is " << config.l2Config.lineSize << " bytes." << endl;
+    printReplacementPolicy(out, config.l2Config.policy);
+    printPrefetcher(out, config.l2Config.prefetcher, config.l2Config.prefetchDegree);
+    out << "Number of bits used for the index is " << l2IndexBits << "." << endl;
+    out << "Number of bits used for the offset is " << l2OffsetBits << "." << endl
+         << endl;
+    if (config.useVirtualAddresses == 1)
+    {
+        out << "The addresses read in are virtual addresses." << endl
+             << endl;
+    }
+    else
+    {
+        out << "The addresses read in are physical addresses." << endl
+             << endl;
+    }
+    if (config.numCores > 1)
+    {
+        out << "There are " << config.numCores << " cores, each with its own TLB and D-cache, kept coherent with MESI." << endl
+             << endl;
+    }
+}
+
+void Simulator::ptinit()
+{
+    pageTableList.resize(config.ptConfig.numPhysicalPages);
+    for (int i = 0; i < config.ptConfig.numPhysicalPages; ++i)
+    {
+        Page page;
+        page.physicalPage = -1;
+        page.index = -1;
+        page.virtualPage = -1;
+        page.valid = false;
+        page.dirty = false;
+        pageTableList[i] = page;
+    }
+    initPageIndex(pageIndex, config.ptConfig.numPhysicalPages);
+    initReplacementState(pageTableReplacement, config.ptConfig.policy, 1, config.ptConfig.numPhysicalPages, 1);
+    for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+    {
+        HugePageFrames &frames = hugeFrames[size - 1];
+        int numPages = config.ptConfig.hugePages[size - 1].numPages;
+        frames.pages.assign(numPages, Page());
+        frames.lastFrame = -1;
+        if (numPages > 0)
+        {
+            initPageIndex(frames.index, numPages);
+            initReplacementState(frames.replacement, config.ptConfig.policy, 1, numPages, 1);
+        }
+    }
+}
+
+// Writes an evicted dirty DC line into L2, allocating without a fetch from memory since
+// the whole line is overwritten. Write-backs are not demand accesses, so they leave the
+// L2 hit and miss counts alone.
+void Simulator::writeBackToL2(uint64_t lineAddress)
+{
+    // A DC line longer than an L2 line covers several of them
+    for (int offset = 0; offset < config.dcConfig.lineSize; offset += config.l2Config.lineSize)
+    {
+        int index = layout.l2Index.extract(lineAddress + offset);
+        int tag = layout.l2Tag.extract(lineAddress + offset);
+        int way = l2Cache.lookup(index, tag);
+        if (way == -1)
+        {
+            way = fillL2(index, tag, false);
+        }
+        l2Cache.markDirty(index, way);
+    }
+}
+
+// Fills an L2 line, counting the write-back of a dirty victim and, with a prefetcher,
+// what the fill did to prefetched lines.
+int Simulator::fillL2(int index, int tag, bool prefetch)
+{
+    Eviction evicted;
+    int way = l2Cache.fill(index, tag, evicted);
+    if (evicted.dirty)
+    {
+        l2WriteBacks++;
+    }
+    if (l2Prefetcher.type != PREFETCH_NONE)
+    {
+        if (evicted.prefetched)
+        {
+            l2Prefetcher.counts.unused++;
+        }
+        else if (prefetch && evicted.tag != -1)
+        {
+            l2Prefetcher.evictedLines.insert(layout.l2LineAddress(evicted.tag, index));
+        }
+    }
+    return way;
+}
+
+// Cycles spent in the caches and memory so far, the clock prefetch timeliness is
+// measured against. Translation is left out so that the cache half of a pipelined run
+// never reads the translation counters.
+uint64_t Simulator::cacheCycles() const
+{
+    return dcCycles + l2Cycles + memoryCycles + walkCycles;
+}
+
+// A demand access used a prefetched line for the first time.
+void countPrefetchUse(Prefetcher &prefetcher, int line, uint64_t now)
+{
+    prefetcher.counts.useful++;
+    if (now < prefetcher.readyCycle[line])
+    {
+        prefetcher.counts.late++;
+    }
+}
+
+// Prefetches stay within the page of the access that triggered them: the next
+// physical page holds unrelated data.
+bool prefetchInPage(uint64_t lineAddress, uint64_t address, int pageShift)
+{
+    return (lineAddress >> pageShift) == (address >> pageShift);
+}
+
+// Fetches the lines the DC prefetcher of core asks for. They come from L2, or from
+// memory on an L2 miss, like a demand fill, but cost the core no cycles and leave the
+// demand hit and miss counts alone.
+void Simulator::issueDCPrefetches(int core, uint64_t physicalAddress, bool trigger)
+{
+    CoreState &state = cores[core];
+    Prefetcher &prefetcher = state.prefetcher;
+    prefetchLines.clear();
+    prefetchCandidates(prefetcher, physicalAddress, config.dcConfig.lineSize, trigger, prefetchLines);
+    for (uint64_t lineAddress : prefetchLines)
+    {
+        int index = layout.dcIndex.extract(lineAddress);
+        int tag = layout.dcTag.extract(lineAddress);
+        if (!prefetchInPage(lineAddress, physicalAddress, layout.pageOffsetBits) || state.dataCache.lookup(index, tag) != -1)
+        {
+            continue;
+        }
+        uint64_t latency = config.timing.memoryLatency;
+        if (config.useL2Cache == 1)
+        {
+            int l2Index = layout.l2Index.extract(lineAddress);
+            int l2Tag = layout.l2Tag.extract(lineAddress);
+            latency = config.timing.l2Latency;
+            int l2Way = l2Cache.lookup(l2Index, l2Tag);
+            if (l2Way == -1)
+            {
+                fillL2(l2Index, l2Tag, false);
+                mainMemoryRefs++;
+                latency += config.timing.memoryLatency;
+            }
+            else if (l2Cache.takePrefetched(l2Index, l2Way))
+            {
+                countPrefetchUse(l2Prefetcher, l2Index * l2Cache.ways + l2Way, cacheCycles());
+            }
+        }
+        bool shared = cores.size() > 1 && snoopRead(core, index, tag);
+
+        Eviction evicted;
+        int way = state.dataCache.fill(index, tag, evicted);
+        dcFills++;
+        if (evicted.dirty)
+        {
+            writeBackDCLine(layout.dcLineAddress(evicted.tag, index));
+        }
+        if (evicted.prefetched)
+        {
+            prefetcher.counts.unused++;
+        }
+        else if (evicted.tag != -1)
+        {
+            prefetcher.evictedLines.insert(layout.dcLineAddress(evicted.tag, index));
+        }
+        prefetcher.evictedLines.erase(layout.dcLineAddress(tag, index));
+        state.dataCache.entry(index, way) = DCLineState();
+        state.dataCache.entry(index, way).shared = shared;
+        state.dataCache.markPrefetched(index, way);
+        prefetcher.readyCycle[index * state.dataCache.ways + way] = cacheCycles() + latency;
+        prefetcher.counts.issued++;
+    }
+}
+
+// Fetches the lines the L2 prefetcher asks for from memory.
+void Simulator::issueL2Prefetches(uint64_t physicalAddress, bool trigger)
+{
+    prefetchLines.clear();
+    prefetchCandidates(l2Prefetcher, physicalAddress, config.l2Config.lineSize, trigger, prefetchLines);
+    for (uint64_t lineAddress : prefetchLines)
+    {
+        int index = layout.l2Index.extract(lineAddress);
+        int tag = layout.l2Tag.extract(lineAddress);
+        if (!prefetchInPage(lineAddress, physicalAddress, layout.pageOffsetBits) || l2Cache.lookup(index, tag) != -1)
+        {
+            continue;
+        }
+        int way = fillL2(index, tag, true);
+        mainMemoryRefs++;
+        l2Prefetcher.evictedLines.erase(layout.l2LineAddress(tag, index));
+        l2Cache.markPrefetched(index, way);
+        l2Prefetcher.readyCycle[index * l2Cache.ways + way] = cacheCycles() + config.timing.memoryLatency;
+        l2Prefetcher.counts.issued++;
+    }
+}
+
+// A dirty DC line leaving its core, evicted or taken by another core.
+void Simulator::writeBackDCLine(uint64_t lineAddress)
+{
+    dcWriteBacks++;
+    if (config.useL2Cache == 1)
+    {
+        writeBackToL2(lineAddress);
+    }
+}
+
+// Snoops the other cores for a read miss of core. A Modified copy is written back and
+// every copy becomes Shared. Returns whether any other core holds the line.
+bool Simulator::snoopRead(int core, int set, int tag)
+{
+    bool found = false;
+    for (size_t other = 0; other < cores.size(); other++)
+    {
+        CoreState &state = cores[other];
+        int way = other != static_cast<size_t>(core) ? state.dataCache.lookup(set, tag) : -1;
+        if (way == -1)
+            continue;
+        found = true;
+        if (state.dataCache.isDirty(set, way))
+        {
+            coherenceWriteBacks++;
+            writeBackDCLine(layout.dcLineAddress(tag, set));
+            state.dataCache.markClean(set, way);
+        }
+        state.dataCache.entry(set, way).shared = true;
+    }
+    return found;
+}
+
+// Invalidates the other cores' copies of a line core is storing word to, writing back
+// a Modified one first so the store's fetch from L2 sees its data.
+void Simulator::snoopInvalidate(int core, int set, int tag, uint64_t lineAddress, uint64_t word)
+{
+    for (size_t other = 0; other < cores.size(); other++)
+    {
+        CoreState &state = cores[other];
+        int way = other != static_cast<size_t>(core) ? state.dataCache.lookup(set, tag) : -1;
+        if (way == -1)
+            continue;
+        if (state.dataCache.isDirty(set, way))
+        {
+            coherenceWriteBacks++;
+            writeBackDCLine(lineAddress);
+        }
+        if (state.dataCache.takePrefetched(set, way))
+        {
+            state.prefetcher.counts.unused++;
+        }
+        state.dataCache.invalidate(set, way);
+        state.invalidations++;
+        state.invalidatedLines[lineAddress] |= word;
+    }
+}
+
+// A miss on a line another core's store invalidated is a coherence miss. It is false
+// sharing when no other core has written the word being accessed since then: the words
+// written by the invalidating stores and by the current owner's copy.
+void Simulator::countCoherenceMiss(CoreState &state, int core, int set, int tag, uint64_t lineAddress, uint64_t word)
+{
+    auto found = state.invalidatedLines.find(lineAddress);
+    if (found == state.invalidatedLines.end())
+        return;
+    uint64_t written = found->second;
+    state.invalidatedLines.erase(found);
+    state.coherenceMisses++;
+    for (size_t other = 0; other < cores.size(); other++)
+    {
+        int way = other != static_cast<size_t>(core) ? cores[other].dataCache.lookup(set, tag) : -1;
+        if (way != -1)
+        {
+            written |= cores[other].dataCache.entry(set, way).writtenWords;
+        }
+    }
+    if ((written & word) == 0)
+    {
+        state.falseSharing++;
+        falseSharingLines[lineAddress]++;
+    }
+}
+
+Simulator::Simulator(const Configuration &configuration) : config(configuration)
+{
+    initializeMemoryHierarchy();
+}
+
+void Simulator::initializeMemoryHierarchy()
+{
+    resetStatistics();
+    currenPhysicalPageAddress = -1;
+    trace = 0;
+
+    calculateBits();
+    cores.assign(max(config.numCores, 1), CoreState());
+    int walkCacheLevels = config.ptConfig.walkCacheEntries > 0 ? max(config.ptConfig.levels - 1, 0) : 0;
+    for (CoreState &core : cores)
+    {
+        core.dataCache.init(config.dcConfig.numSets, config.dcConfig.setSize, config.dcConfig.policy);
+        core.dtlb.init(config.dtlbConfig.numSets, config.dtlbConfig.setSize, config.dtlbConfig.policy);
+        core.walkCaches.resize(walkCacheLevels);
+        for (PageWalkCache &walkCache : core.walkCaches)
+        {
+            walkCache.init(1, config.ptConfig.walkCacheEntries, POLICY_LRU);
+        }
+        core.hugeTLBs.resize(HUGE_PAGE_SIZES);
+        for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+        {
+            const HugePageConfig &hugePages = config.ptConfig.hugePages[size - 1];
+            if (hugePages.numPages > 0 && hugePages.tlbSets > 0)
+            {
+                core.hugeTLBs[size - 1].init(hugePages.tlbSets, hugePages.tlbSetSize, config.dtlbConfig.policy);
+            }
+        }
+    }
+    walkCacheHits.assign(walkCacheLevels, 0);
+    dtlbSizeHits.assign(HUGE_PAGE_SIZES + 1, 0);
+    dtlbSizeMisses.assign(HUGE_PAGE_SIZES + 1, 0);
+    pageSizeFaults.assign(HUGE_PAGE_SIZES + 1, 0);
+    pageTableNodes.clear();
+    l2Cache.init(config.l2Config.numSets, config.l2Config.setSize, config.l2Config.policy);
+    for (CoreState &core : cores)
+    {
+        initPrefetcher(core.prefetcher, config.dcConfig.prefetcher, config.dcConfig.prefetchDegree,
+                       config.dcConfig.numSets * config.dcConfig.setSize, layout.pageOffsetBits);
+    }
+    initPrefetcher(l2Prefetcher, config.l2Config.prefetcher, config.l2Config.prefetchDegree,
+                   config.l2Config.numSets * config.l2Config.setSize, layout.pageOffsetBits);
+    ptinit();
+}
+
+bool Simulator::performL2CacheAccess(uint64_t physicalAddess, int pageOffset, char accessType, TraceData &row)
+{
+    PROFILE_SCOPE(PROFILE_L2);
+    int index = layout.l2Index.extract(physicalAddess);
+    int tag = layout.l2Tag.extract(physicalAddess);
+    // cout<<" l2tag: "<< hex << tag <<" | ";
+    // cout<<" l2Index: "<<index<<" | ";
+
+    row.l2Index = index;
+    row.l2Tag = tag;
+    l2Cycles += config.timing.l2Latency;
+    int way = l2Cache.lookup(index, tag);
+    bool hit = way != -1;
+    bool trigger = !hit;
+    if (hit)
+    {
+        row.l2Res = "hit ";
+        l2Hits++;
+        l2Cache.touch(index, way);
+        if (l2Cache.takePrefetched(index, way))
+        {
+            countPrefetchUse(l2Prefetcher, index * l2Cache.ways + way, cacheCycles());
+            trigger = true;
+        }
+    }
+    else
+    {
+        row.l2Res = "miss";
+        l2Misses++;
+        if (l2Prefetcher.type != PREFETCH_NONE && l2Prefetcher.evictedLines.erase(layout.l2LineAddress(tag, index)) != 0)
+        {
+            l2Prefetcher.counts.pollutionMisses++;
+        }
+        way = fillL2(index, tag, false);
+        mainMemoryRefs++;
+        memoryCycles += config.timing.memoryLatency;
+    }
+    // L2 is write-back and write-allocate
+    if (accessType == 'W')
+    {
+        l2Cache.markDirty(index, way);
+    }
+    if (l2Prefetcher.type != PREFETCH_NONE)
+    {
+        issueL2Prefetches(physicalAddess, trigger);
+    }
+    return hit;
+}
+
+// Sends a DC fill or write-through on to L2, or straight to memory without one.
+void Simulator::forwardFromDC(uint64_t physicalAddress, int pageOffset, char accessType, TraceData &row)
+{
+    if (config.useL2Cache == 1)
+    {
+        performL2CacheAccess(physicalAddress, pageOffset, accessType, row);
+    }
+    else
+    {
+        memoryCycles += config.timing.memoryLatency;
+    }
+}
+
+// With more than one core the DCs are kept coherent by snooping the other cores on
+// misses and on stores to Shared lines. Data always comes from L2: a Modified copy
+// another core needs is written back first rather than forwarded cache to cache.
+void Simulator::performDataCacheAccess(uint64_t physicalAddess, int pageOffSet, char accessType, TraceData &row)
+{
+    CoreState &core = cores[row.core];
+    CacheLevel<DCLineState> &dataCache = core.dataCache;
+    int index = layout.dcIndex.extract(physicalAddess);
+    int tag = layout.dcTag.extract(physicalAddess);
+    // cout<<" dctag: "<< hex << tag <<" | ";
+    // cout<<" dcIndex: "<<index<<" | ";
+
+    row.dcIndex = index;
+    row.dcTag = tag;
+    dcCycles += config.timing.dcLatency;
+
+    bool coherent = cores.size() > 1;
+    uint64_t lineAddress = 0;
+    uint64_t word = 0;
+    if (coherent)
+    {
+        // Up to 64 words per line, one bit each
+        int lineSize = config.dcConfig.lineSize;
+        int wordBytes = max(ACCESS_BYTES, lineSize / 64);
+        lineAddress = layout.dcLineAddress(tag, index);
+        word = 1ull << ((physicalAddess & (lineSize - 1)) / wordBytes);
+    }
+
+    Prefetcher &prefetcher = core.prefetcher;
+    int key = dataCache.lookup(index, tag);
+    bool trigger = key == -1;
+    if (key != -1)
+    {
+        row.dcRes = "hit";
+        dcHits++;
+        core.dcHits++;
+        dataCache.touch(index, key);
+        if (dataCache.takePrefetched(index, key))
+        {
+            countPrefetchUse(prefetcher, index * dataCache.ways + key, cacheCycles());
+            trigger = true;
+        }
+    }
+    else
+    {
+        row.dcRes = "miss";
+        dcMisses++;
+        core.dcMisses++;
+        if (coherent)
+        {
+            countCoherenceMiss(core, row.core, index, tag, lineAddress, word);
+        }
+        if (prefetcher.type != PREFETCH_NONE && prefetcher.evictedLines.erase(layout.dcLineAddress(tag, index)) != 0)
+        {
+            prefetcher.counts.pollutionMisses++;
+        }
+    }
+
+    Eviction evicted;
+    if (config.dcConfig.writeThroughOrNoWriteAllocate == 1)
+    {
+        // Write: always through to L2, never allocated
+        bool writeToL2 = accessType == 'W';
+        // Read
+        bool writeTodc = accessType != 'W' && key == -1;
+        if (writeToL2)
+        {
+            if (coherent)
+            {
+                snoopInvalidate(row.core, index, tag, lineAddress, word);
+            }
+            writeThroughs++;
+            forwardFromDC(physicalAddess, pageOffSet, accessType, row);
+        }
+        if (writeTodc)
+        {
+            bool shared = coherent && snoopRead(row.core, index, tag);
+            forwardFromDC(physicalAddess, pageOffSet, accessType, row);
+            key = dataCache.fill(index, tag, evicted);
+            dcFills++;
+            dataCache.entry(index, key) = DCLineState();
+            dataCache.entry(index, key).shared = shared;
+        }
+    }
+    else
+    {
+        // Write-back, write-allocate: a miss fetches the line, writes only mark it dirty
+        // and the line reaches L2 when it is evicted.
+        if (key == -1)
+        {
+            bool shared = false;
+            if (coherent)
+            {
+                // A store miss reads for ownership
+                if (accessType == 'W')
+                    snoopInvalidate(row.core, index, tag, lineAddress, word);
+                else
+                    shared = snoopRead(row.core, index, tag);
+            }
+            forwardFromDC(physicalAddess, pageOffSet, 'R', row);
+            key = dataCache.fill(index, tag, evicted);
+            dcFills++;
+            if (evicted.dirty)
+            {
+                writeBackDCLine(layout.dcLineAddress(evicted.tag, index));
+            }
+            dataCache.entry(index, key) = DCLineState();
+            dataCache.entry(index, key).shared = shared;
+        }
+        else if (accessType == 'W' && dataCache.entry(index, key).shared)
+        {
+            snoopInvalidate(row.core, index, tag, lineAddress, word);
+            core.upgrades++;
+            dataCache.entry(index, key).shared = false;
+        }
+        if (accessType == 'W')
+        {
+            dataCache.markDirty(index, key);
+            dataCache.entry(index, key).writtenWords |= word;
+        }
+    }
+
+    if (prefetcher.type != PREFETCH_NONE)
+    {
+        if (evicted.prefetched)
+        {
+            prefetcher.counts.unused++;
+        }
+        issueDCPrefetches(row.core, physicalAddess, trigger);
+    }
+}
+
+// Node number of the radix page table node at level that the virtual page numbers
+// starting with prefix go through. Nodes are numbered as walks first reach them and
+// wrap around the page table region, so very sparse traces share node pages.
+int Simulator::pageTableNode(int level, uint64_t prefix)
+{
+    uint64_t key = (prefix << 3) | static_cast<uint64_t>(level);
+    auto found = pageTableNodes.find(key);
+    if (found != pageTableNodes.end())
+    {
+        return found->second;
+    }
+    int node = static_cast<int>(pageTableNodes.size() % static_cast<uint64_t>(config.ptConfig.numPhysicalPages));
+    pageTableNodes.emplace(key, node);
+    return node;
+}
+
+// Walks the radix page table: looks for the deepest upper level entry the core's page
+// walk caches hold, then leaves the addresses of the entries still to be read, one per
+// level below it, in row for accessCaches. The walk of a huge page ends pageSize levels
+// early, at the entry mapping it, so only the levels above that one are walk cached.
+void Simulator::walkPageTable(uint64_t virtualPageNumber, int pageSize, TraceData &row)
+{
+    CoreState &core = cores[row.core];
+    int levels = config.ptConfig.levels;
+    int leaf = levels - 1 - pageSize;
+    int cachedLevels = min(static_cast<int>(core.walkCaches.size()), leaf);
+    pageWalks++;
+    int start = 0;
+    for (int level = cachedLevels - 1; level >= 0; level--)
+    {
+        PageWalkCache &walkCache = core.walkCaches[level];
+        int way = walkCache.lookup(0, static_cast<int64_t>(virtualPageNumber >> (walkLevelBits * (levels - 1 - level))));
+        if (way != -1)
+        {
+            walkCache.touch(0, way);
+            walkCacheHits[level]++;
+            start = level + 1;
+            break;
+        }
+    }
+
+    uint64_t entryMask = (1ull << walkLevelBits) - 1;
+    row.walkReads = 0;
+    for (int level = start; level <= leaf; level++)
+    {
+        int shift = walkLevelBits * (levels - 1 - level);
+        uint64_t node = pageTableNode(level, virtualPageNumber >> shift >> walkLevelBits);
+        uint64_t entry = (virtualPageNumber >> shift) & entryMask;
+        row.walkAddresses[row.walkReads++] = pageTableBase + node * config.ptConfig.pageSize + entry * PTE_BYTES;
+        if (level < cachedLevels)
+        {
+            core.walkCaches[level].fill(0, static_cast<int64_t>(virtualPageNumber >> shift));
+        }
+    }
+}
+
+// Reads one page table entry for a walk of core: from the DC, or into it from L2 or
+// memory like a demand read miss. The reads count towards the walk, not the demand hit
+// and miss counts, and trigger no prefetches.
+void Simulator::readPageTableEntry(int core, uint64_t address)
+{
+    CoreState &state = cores[core];
+    CacheLevel<DCLineState> &dataCache = state.dataCache;
+    int index = layout.dcIndex.extract(address);
+    int tag = layout.dcTag.extract(address);
+    pteReads++;
+    walkCycles += config.timing.dcLatency;
+    int way = dataCache.lookup(index, tag);
+    if (way != -1)
+    {
+        pteDCHits++;
+        dataCache.touch(index, way);
+        return;
+    }
+
+    bool shared = cores.size() > 1 && snoopRead(core, index, tag);
+    if (config.useL2Cache == 1)
+    {
+        int l2Index = layout.l2Index.extract(address);
+        int l2Tag = layout.l2Tag.extract(address);
+        walkCycles += config.timing.l2Latency;
+        int l2Way = l2Cache.lookup(l2Index, l2Tag);
+        if (l2Way != -1)
+        {
+            pteL2Hits++;
+            l2Cache.touch(l2Index, l2Way);
+        }
+        else
+        {
+            fillL2(l2Index, l2Tag, false);
+            mainMemoryRefs++;
+            pteMemoryRefs++;
+            walkCycles += config.timing.memoryLatency;
+        }
+    }
+    else
+    {
+        pteMemoryRefs++;
+        walkCycles += config.timing.memoryLatency;
+    }
+
+    Eviction evicted;
+    way = dataCache.fill(index, tag, evicted);
+    dcFills++;
+    if (evicted.dirty)
+    {
+        writeBackDCLine(layout.dcLineAddress(evicted.tag, index));
+    }
+    if (evicted.prefetched)
+    {
+        state.prefetcher.counts.unused++;
+    }
+    dataCache.entry(index, way) = DCLineState();
+    dataCache.entry(index, way).shared = shared;
+}
+
+// Page size of the region holding the address: 0 for base pages, otherwise the levels
+// above the last that its huge pages are mapped at.
+int Simulator::pageSizeOf(uint64_t virtualAddress) const
+{
+    for (const HugePageRegion &region : config.ptConfig.hugePageRegions)
+    {
+        if (virtualAddress - region.start < region.end - region.start)
+        {
+            return region.pageSize;
+        }
+    }
+    return 0;
+}
+
+// Finds virtualPage among the resident pages of one size, or faults it into the next
+// unused frame or the replacement victim, and returns its frame.
+int Simulator::mapPage(vector<Page> &pages, ReplacementState &replacement, PageIndex &index, int &lastFrame,
+                       uint64_t virtualPage, int pageSize, TraceData &row)
+{
+    int frame = pageIndexFind(index, virtualPage);
+    if (frame != -1)
+    {
+        row.ptRes = "hit";
+        ptHits++;
+        replacementTouch(replacement, 0, frame);
+        return frame;
+    }
+    if (lastFrame < static_cast<int>(pages.size()) - 1)
+    {
+        lastFrame++;
+    }
+    else
+    {
+        lastFrame = replacementVictim(replacement, 0);
+    }
+    frame = lastFrame;
+    row.ptRes = "miss";
+    ptFaults++;
+    diskRefs++;
+    pageSizeFaults[pageSize]++;
+    diskCycles += config.timing.diskLatency;
+    if (pages[frame].valid)
+    {
+        pageIndexErase(index, pages[frame].virtualPage);
+    }
+    Page pageData;
+    pageData.physicalPage = frame;
+    pageData.index = frame;
+    pageData.virtualPage = virtualPage;
+    pageData.valid = true;
+    pageData.dirty = false;
+    pages[frame] = pageData;
+    pageIndexInsert(index, virtualPage, frame);
+    replacementInsert(replacement, 0, frame);
+    return frame;
+}
+
+// The returned page's physicalPage is the base page holding virtualPageNumber, also
+// inside a huge page.
+Page Simulator::performPageTableLookup(uint64_t virtualPageNumber, int pageSize, TraceData &row)
+{
+    pageTableRefs++;
+    if (config.ptConfig.levels > 0)
+    {
+        walkPageTable(virtualPageNumber, pageSize, row);
+    }
+    else
+    {
+        pageWalkCycles += config.timing.pageWalkLatency;
+    }
+    if (pageSize == 0)
+    {
+        int frame = mapPage(pageTableList, pageTableReplacement, pageIndex, currenPhysicalPageAddress, virtualPageNumber, 0, row);
+        return pageTableList[frame];
+    }
+    HugePageFrames &frames = hugeFrames[pageSize - 1];
+    int shift = walkLevelBits * pageSize;
+    int frame = mapPage(frames.pages, frames.replacement, frames.index, frames.lastFrame, virtualPageNumber >> shift, pageSize, row);
+    Page page = frames.pages[frame];
+    page.physicalPage = frames.firstPage + frame * frames.basePages + static_cast<int>(virtualPageNumber & ((1ull << shift) - 1));
+    return page;
+}
+
+// Returns the physical page of the address, walking the page table on a TLB miss.
+// Huge pages without a TLB array of their own are cached in the base page TLB.
+int Simulator::performTLBLookup(uint64_t virtualAddress, int pageSize, CoreState &core, TraceData &row)
+{
+    CacheLevel<int, 0, int64_t> &dtlb = core.dtlb;
+    uint64_t virtualPageNumber = layout.virtualPage.extract(virtualAddress);
+    if (pageSize > 0 && config.ptConfig.hugePages[pageSize - 1].tlbSets > 0)
+    {
+        return performHugeTLBLookup(virtualPageNumber, pageSize, core, row);
+    }
+    int index = layout.tlbIndex.extract(virtualAddress);
+    int64_t tag = static_cast<int64_t>(layout.tlbTag.extract(virtualAddress));
+
+    row.tlbIndex = index;
+    row.tlbTag = tag;
+    tlbCycles += config.timing.tlbLatency;
+    int way = dtlb.lookup(index, tag);
+    if (way != -1)
+    {
+        dtlbHits++;
+        dtlbSizeHits[pageSize]++;
+        row.tlbRes = "hit";
+        dtlb.touch(index, way);
+        return dtlb.entry(index, way);
+    }
+
+    dtlbMisses++;
+    dtlbSizeMisses[pageSize]++;
+    row.tlbRes = "miss";
+    Page pageData = performPageTableLookup(virtualPageNumber, pageSize, row);
+    way = dtlb.fill(index, tag);
+    dtlb.entry(index, way) = pageData.physicalPage;
+    return pageData.physicalPage;
+}
+
+// Looks a huge page up in the core's TLB array for its size, indexed and tagged by the
+// huge page number. Entries hold the first base page of the frame.
+int Simulator::performHugeTLBLookup(uint64_t virtualPageNumber, int pageSize, CoreState &core, TraceData &row)
+{
+    CacheLevel<int, 0, int64_t> &tlb = core.hugeTLBs[pageSize - 1];
+    int shift = walkLevelBits * pageSize;
+    uint64_t hugePage = virtualPageNumber >> shift;
+    int basePage = static_cast<int>(virtualPageNumber & ((1ull << shift) - 1));
+    int index = static_cast<int>(hugePage & static_cast<uint64_t>(tlb.numSets - 1));
+    int64_t tag = static_cast<int64_t>(hugePage >> hugeTLBIndexBits[pageSize - 1]);
+
+    row.tlbIndex = index;
+    row.tlbTag = tag;
+    tlbCycles += config.timing.tlbLatency;
+    int way = tlb.lookup(index, tag);
+    if (way != -1)
+    {
+        dtlbHits++;
+        dtlbSizeHits[pageSize]++;
+        row.tlbRes = "hit";
+        tlb.touch(index, way);
+        return tlb.entry(index, way) + basePage;
+    }
+
+    dtlbMisses++;
+    dtlbSizeMisses[pageSize]++;
+    row.tlbRes = "miss";
+    Page pageData = performPageTableLookup(virtualPageNumber, pageSize, row);
+    way = tlb.fill(index, tag);
+    tlb.entry(index, way) = pageData.physicalPage - basePage;
+    return pageData.physicalPage;
+}
+
+void Simulator::simulateMemoryAccess(uint64_t virtualAddress, char accessType, int core)
+{
+    traceData = TraceData();
+    uint64_t physicalAddress = translateAccess(virtualAddress, core, traceData);
+    accessCaches(physicalAddress, accessType, traceData);
+}
+
+// Translation half of an access: fills the address and TLB/page table columns of row
+// and returns the physical address. It only touches the TLB, the page table and their
+// counters, so it can run on another thread than accessCaches. Core ids wrap modulo the
+// number of cores.
+uint64_t Simulator::translateAccess(uint64_t virtualAddress, int core, TraceData &row)
+{
+    PROFILE_SCOPE(PROFILE_TRANSLATE);
+    row.core = static_cast<int>(static_cast<unsigned int>(core) % cores.size());
+    int pageOffSet = layout.pageOffset.extract(virtualAddress);
+    row.virtualAddress = static_cast<int64_t>(virtualAddress);
+    row.pageOffset = pageOffSet;
+    uint64_t virtualPageNumber = layout.virtualPage.extract(virtualAddress);
+    row.virtualPage = static_cast<int64_t>(virtualPageNumber);
+    row.walkReads = 0;
+    int pageSize = config.ptConfig.hugePageRegions.empty() ? 0 : pageSizeOf(virtualAddress);
+
+    // Simulate TLB lookup
+    int pageNum;
+    if (config.useTLB == 1)
+    {
+        pageNum = performTLBLookup(virtualAddress, pageSize, cores[row.core], row);
+        row.physicalPage = pageNum;
+    }
+    else
+    {
+        // The flat page table has always been looked up by the whole address here
+        Page page = performPageTableLookup(config.ptConfig.levels > 0 ? virtualPageNumber : virtualAddress, pageSize, row);
+        row.physicalPage = page.physicalPage;
+        pageNum = page.physicalPage;
+    }
+    // printDTLB();
+    // printPageTable();
+
+    return layout.physicalAddress(pageNum, pageOffSet);
+}
+
+// Cache half of an access: the DC and L2 columns of row and their counters.
+void Simulator::accessCaches(uint64_t physicalAddress, char accessType, TraceData &row)
+{
+    PROFILE_SCOPE(PROFILE_DC);
+    // The page walk's entry reads come before the access that needed the translation
+    replayPageWalk(row);
+    // DC LookUP
+    performDataCacheAccess(physicalAddress, row.pageOffset, accessType, row);
+    // printDC();
+    cores[row.core].accesses++;
+
+    if (accessType == 'R')
+    {
+        totalReads++;
+    }
+    else if (accessType == 'W')
+    {
+        totalWrites++;
+    }
+    trace++;
+}
+
+void Simulator::replayPageWalk(TraceData &row)
+{
+    for (int i = 0; i < row.walkReads; i++)
+    {
+        readPageTableEntry(row.core, row.walkAddresses[i]);
+    }
+}
+
+double hitRatio(uint64_t hits, uint64_t misses)
+{
+    return (hits + misses) > 0 ? static_cast<double>(hits) / (hits + misses) : 0;
+}
+
+LevelResult levelResult(const char *result)
+{
+    if (result[0] == 'h')
+        return LEVEL_HIT;
+    if (result[0] == 'm')
+        return LEVEL_MISS;
+    return LEVEL_NOT_ACCESSED;
+}
+
+AccessResult Simulator::access(uint64_t address, bool isWrite, int core)
+{
+    uint64_t cyclesBefore = totalCycles();
+    simulateMemoryAccess(address, isWrite ? 'W' : 'R', core);
+    AccessResult result;
+    result.tlb = levelResult(traceData.tlbRes);
+    result.pageTable = levelResult(traceData.ptRes);
+    result.dataCache = levelResult(traceData.dcRes);
+    result.l2Cache = levelResult(traceData.l2Res);
+    result.physicalAddress = static_cast<int64_t>(layout.physicalAddress(traceData.physicalPage, traceData.pageOffset));
+    result.cycles = static_cast<int>(totalCycles() - cyclesBefore);
+    return result;
+}
+
+// results may be null when only the statistics are wanted.
+void Simulator::accessBatch(const MemoryAccess *accesses, size_t count, AccessResult *results)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (results != nullptr)
+        {
+            results[i] = access(accesses[i].address, accesses[i].isWrite, accesses[i].core);
+        }
+        else
+        {
+            simulateMemoryAccess(accesses[i].address, accesses[i].isWrite ? 'W' : 'R', accesses[i].core);
+        }
+    }
+}
+
+void addPrefetchCounts(PrefetchStats &total, const PrefetchStats &counts)
+{
+    total.issued += counts.issued;
+    total.useful += counts.useful;
+    total.late += counts.late;
+    total.unused += counts.unused;
+    total.pollutionMisses += counts.pollutionMisses;
+}
+
+// Fills in the ratios; demandMisses are the misses the prefetches did not remove.
+void finishPrefetchStats(PrefetchStats &stats, uint64_t demandMisses)
+{
+    stats.accuracy = stats.issued > 0 ? static_cast<double>(stats.useful) / stats.issued : 0;
+    uint64_t wouldMiss = stats.useful + demandMisses;
+    stats.coverage = wouldMiss > 0 ? static_cast<double>(stats.useful) / wouldMiss : 0;
+    stats.timeliness = stats.useful > 0 ? static_cast<double>(stats.useful - stats.late) / stats.useful : 0;
+}
+
+SimulationStats Simulator::stats() const
+{
+    SimulationStats stats;
+    stats.dtlbHits = dtlbHits;
+    stats.dtlbMisses = dtlbMisses;
+    stats.ptHits = ptHits;
+    stats.ptFaults = ptFaults;
+    stats.dcHits = dcHits;
+    stats.dcMisses = dcMisses;
+    stats.l2Hits = l2Hits;
+    stats.l2Misses = l2Misses;
+    stats.totalReads = totalReads;
+    stats.totalWrites = totalWrites;
+    stats.mainMemoryRefs = mainMemoryRefs;
+    stats.pageTableRefs = pageTableRefs;
+    stats.diskRefs = diskRefs;
+    stats.dcWriteBacks = dcWriteBacks;
+    stats.l2WriteBacks = l2WriteBacks;
+    for (const CoreState &core : cores)
+    {
+        stats.coherenceMisses += core.coherenceMisses;
+        stats.invalidations += core.invalidations;
+        stats.upgrades += core.upgrades;
+        stats.falseSharing += core.falseSharing;
+    }
+    stats.coherenceWriteBacks = coherenceWriteBacks;
+    stats.pageWalks = pageWalks;
+    for (uint64_t hits : walkCacheHits)
+    {
+        stats.walkCacheHits += hits;
+    }
+    stats.pteReads = pteReads;
+    stats.pteDCHits = pteDCHits;
+    stats.pteL2Hits = pteL2Hits;
+    stats.pteMemoryRefs = pteMemoryRefs;
+    for (int size = 0; size <= HUGE_PAGE_SIZES; size++)
+    {
+        stats.dtlbSizeHits[size] = dtlbSizeHits[size];
+        stats.dtlbSizeMisses[size] = dtlbSizeMisses[size];
+        stats.pageSizeFaults[size] = pageSizeFaults[size];
+    }
+    stats.tlbReach = config.useTLB == 1 ? tlbReach() : 0;
+    stats.dtlbHitRatio = hitRatio(dtlbHits, dtlbMisses);
+    stats.ptHitRatio = hitRatio(ptHits, ptFaults);
+    stats.dcHitRatio = hitRatio(dcHits, dcMisses);
+    stats.l2HitRatio = hitRatio(l2Hits, l2Misses);
+    stats.ratioOfReads = hitRatio(totalReads, totalWrites);
+
+    stats.tlbCycles = tlbCycles;
+    stats.pageWalkCycles = pageWalkCycles + walkCycles;
+    stats.diskCycles = diskCycles;
+    stats.dcCycles = dcCycles;
+    stats.l2Cycles = l2Cycles;
+    stats.memoryCycles = memoryCycles;
+    stats.totalCycles = totalCycles();
+    uint64_t accesses = totalReads + totalWrites;
+    stats.amat = accesses > 0 ? static_cast<double>(stats.totalCycles) / accesses : 0;
+
+    stats.dcFillBytes = dcFills * config.dcConfig.lineSize;
+    stats.dcWriteBytes = dcWriteBacks * config.dcConfig.lineSize + writeThroughs * ACCESS_BYTES;
+    stats.l2FillBytes = mainMemoryRefs * config.l2Config.lineSize;
+    stats.l2WriteBytes = l2WriteBacks * config.l2Config.lineSize;
+    stats.pageInBytes = diskRefs * config.ptConfig.pageSize;
+    for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+    {
+        stats.pageInBytes += pageSizeFaults[size] * (pageSizeBytes(config.ptConfig, size) - config.ptConfig.pageSize);
+    }
+    uint64_t memoryBytes = config.useL2Cache == 1 ? stats.l2FillBytes + stats.l2WriteBytes : stats.dcFillBytes + stats.dcWriteBytes;
+    stats.memoryBandwidth = stats.totalCycles > 0 ? static_cast<double>(memoryBytes) / stats.totalCycles : 0;
+
+    for (const CoreState &core : cores)
+    {
+        addPrefetchCounts(stats.dcPrefetch, core.prefetcher.counts);
+    }
+    finishPrefetchStats(stats.dcPrefetch, dcMisses);
+    addPrefetchCounts(stats.l2Prefetch, l2Prefetcher.counts);
+    finishPrefetchStats(stats.l2Prefetch, l2Misses);
+    return stats;
+}
+
+// Bytes the TLB arrays of one core map when every entry is valid.
+uint64_t Simulator::tlbReach() const
+{
+    uint64_t reach = static_cast<uint64_t>(config.dtlbConfig.numSets) * config.dtlbConfig.setSize * config.ptConfig.pageSize;
+    for (int size = 1; size <= HUGE_PAGE_SIZES; size++)
+    {
+        const HugePageConfig &hugePages = config.ptConfig.hugePages[size - 1];
+        if (hugePages.numPages > 0)
+        {
+            reach += static_cast<uint64_t>(hugePages.tlbSets) * hugePages.tlbSetSize * pageSizeBytes(config.ptConfig, size);
+        }
+    }
+    return reach;
+}
+
+uint64_t Simulator::totalCycles() const
+{
+    return tlbCycles + pageWalkCycles + diskCycles + dcCycles + l2Cycles + memoryCycles + walkCycles;
+}
+
+// Checkpoint files: the magic "MHCP" and a version, the shape of the configuration, the
+// trace offset, then the counters and every structure in a fixed order. Each value is
+// an 8 byte little-endian integer and each vector its length followed by its elements.
+const char CHECKPOINT_MAGIC[4] = {'M', 'H', 'C', 'P'};
+const uint64_t CHECKPOINT_VERSION = 3;
+
+struct CheckpointWriter
+{
+    vector<unsigned char> bytes;
+};
+
+struct CheckpointReader
+{
+    vector<unsigned char> bytes;
+    size_t pos = 0;
+    bool ok = true;
+};
+
+// Every counter reset by resetStatistics, in checkpoint order.
+uint64_t Simulator::*const SIMULATOR_COUNTERS[] = {
+    &Simulator::ptHits, &Simulator::ptFaults, &Simulator::dcHits, &Simulator::dcMisses, &Simulator::l2Hits,
+    &Simulator::l2Misses, &Simulator::totalReads, &Simulator::totalWrites, &Simulator::mainMemoryRefs,
+    &Simulator::pageTableRefs, &Simulator::diskRefs, &Simulator::dcWriteBacks, &Simulator::l2WriteBacks,
+    &Simulator::dcFills, &Simulator::writeThroughs, &Simulator::coherenceWriteBacks, &Simulator::dtlbHits,
+    &Simulator::dtlbMisses,
+};
+uint64_t Simulator::*const SIMULATOR_CYCLES[] = {
+    &Simulator::tlbCycles, &Simulator::pageWalkCycles, &Simulator::diskCycles,
+    &Simulator::dcCycles, &Simulator::l2Cycles, &Simulator::memoryCycles, &Simulator::walkCycles,
+};
+// The page walk counters, which grow faster than the access count
+uint64_t Simulator::*const SIMULATOR_WALK_COUNTERS[] = {
+    &Simulator::pageWalks, &Simulator::pteReads, &Simulator::pteDCHits, &Simulator::pteL2Hits, &Simulator::pteMemoryRefs,
+};
+uint64_t CoreState::*const CORE_COUNTERS[] = {
+    &CoreState::accesses, &CoreState::dcHits, &CoreState::dcMisses, &CoreState::coherenceMisses,
+    &CoreState::falseSharing, &CoreState::invalidations, &CoreState::upgrades,
+};
+uint64_t PrefetchStats::*const PREFETCH_COUNTERS[] = {
+    &PrefetchStats::issued, &PrefetchStats::useful, &PrefetchStats::late, &PrefetchStats::unused, &PrefetchStats::pollutionMisses,
+};
+
+void checkpointPut(CheckpointWriter &writer, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        writer.bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+uint64_t checkpointGet(CheckpointReader &reader)
+{
+    if (!reader.ok || reader.bytes.size() - reader.pos < 8)
+    {
+        reader.ok = false;
+        return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        value = (value << 8) | reader.bytes[reader.pos + i];
+    }
+    reader.pos += 8;
+    return value;
+}
+
+// Signed values keep their sign through the 64 bit two's complement representation.
+template <typename T, typename Allocator>
+void checkpointPutVector(CheckpointWriter &writer, const vector<T, Allocator> &values)
+{
+    checkpointPut(writer, values.size());
+    for (const T &value : values)
+    {
+        checkpointPut(writer, static_cast<uint64_t>(static_cast<int64_t>(value)));
+    }
+}
+
+template <typename T, typename Allocator>
+void checkpointGetVector(CheckpointReader &reader, vector<T, Allocator> &values)
+{
+    uint64_t count = checkpointGet(reader);
+    if (!reader.ok || count > (reader.bytes.size() - reader.pos) / 8)
+    {
+        reader.ok = false;
+        return;
+    }
+    values.resize(count);
+    for (T &value : values)
+    {
+        value = static_cast<T>(static_cast<int64_t>(checkpointGet(reader)));
+    }
+}
+
+void checkpointPutPayload(CheckpointWriter &writer, int physicalPage)
+{
+    checkpointPut(writer, static_cast<uint64_t>(static_cast<int64_t>(physicalPage)));
+}
+
+void checkpointPutPayload(CheckpointWriter &writer, const DCLineState &line)
+{
+    checkpointPut(writer, line.shared);
+    checkpointPut(writer, line.writtenWords);
+}
+
+void checkpointPutPayload(CheckpointWriter &, const NoPayload &)
+{
+}
+
+void checkpointGetPayload(CheckpointReader &reader, int &physicalPage)
+{
+    physicalPage = static_cast<int>(static_cast<int64_t>(checkpointGet(reader)));
+}
+
+void checkpointGetPayload(CheckpointReader &reader, DCLineState &line)
+{
+    line.shared = checkpointGet(reader) != 0;
+    line.writtenWords = checkpointGet(reader);
+}
+
+void checkpointGetPayload(CheckpointReader &, NoPayload &)
+{
+}
+
+void checkpointPutReplacement(CheckpointWriter &writer, const ReplacementState &state)
+{
+    checkpointPut(writer, state.policy);
+    checkpointPut(writer, state.ways);
+    checkpointPutVector(writer, state.validCount);
+    checkpointPutVector(writer, state.hitCount);
+    checkpointPutVector(writer, state.newer);
+    checkpointPutVector(writer, state.older);
+    checkpointPutVector(writer, state.mru);
+    checkpointPutVector(writer, state.lru);
+    checkpointPutVector(writer, state.treeBits);
+    checkpointPut(writer, state.treeLeaves);
+    checkpointPutVector(writer, state.fifoNext);
+    checkpointPut(writer, state.randomState);
+    checkpointPutVector(writer, state.rrpv);
+}
+
+// True if every value lies in [low, high).
+bool checkpointValuesInRange(const vector<int> &values, int low, int high)
+{
+    for (int value : values)
+    {
+        if (value < low || value >= high)
+            return false;
+    }
+    return true;
+}
+
+// The state is already initialized for the configuration, so the loaded one must have
+// the same policy and sizes, and every stored way index must name one of its ways.
+void checkpointGetReplacement(CheckpointReader &reader, ReplacementState &state)
+{
+    ReplacementPolicy policy = state.policy;
+    int ways = state.ways;
+    int treeLeaves = state.treeLeaves;
+    const size_t sizes[] = {state.validCount.size(), state.hitCount.size(), state.newer.size(), state.older.size(), state.mru.size(),
+                            state.lru.size(), state.treeBits.size(), state.fifoNext.size(), state.rrpv.size()};
+    state.policy = static_cast<ReplacementPolicy>(checkpointGet(reader));
+    state.ways = static_cast<int>(checkpointGet(reader));
+    checkpointGetVector(reader, state.validCount);
+    checkpointGetVector(reader, state.hitCount);
+    checkpointGetVector(reader, state.newer);
+    checkpointGetVector(reader, state.older);
+    checkpointGetVector(reader, state.mru);
+    checkpointGetVector(reader, state.lru);
+    checkpointGetVector(reader, state.treeBits);
+    state.treeLeaves = static_cast<int>(checkpointGet(reader));
+    checkpointGetVector(reader, state.fifoNext);
+    state.randomState = static_cast<unsigned int>(checkpointGet(reader));
+    checkpointGetVector(reader, state.rrpv);
+
+    const size_t loadedSizes[] = {state.validCount.size(), state.hitCount.size(), state.newer.size(), state.older.size(), state.mru.size(),
+                                  state.lru.size(), state.treeBits.size(), state.fifoNext.size(), state.rrpv.size()};
+    if (state.policy != policy || state.ways != ways || state.treeLeaves != treeLeaves || !equal(begin(sizes), end(sizes), begin(loadedSizes)))
+    {
+        reader.ok = false;
+        return;
+    }
+    // -1 ends an LRU list
+    if (!checkpointValuesInRange(state.validCount, 0, ways + 1) || !checkpointValuesInRange(state.newer, -1, ways) ||
+        !checkpointValuesInRange(state.older, -1, ways) || !checkpointValuesInRange(state.mru, -1, ways) ||
+        !checkpointValuesInRange(state.lru, -1, ways) || !checkpointValuesInRange(state.fifoNext, 0, ways))
+    {
+        reader.ok = false;
+        return;
+    }
+    for (unsigned char value : state.rrpv)
+    {
+        if (value > SRRIP_MAX_RRPV)
+        {
+            reader.ok = false;
+            return;
+        }
+    }
+}
+
+template <typename Payload, int Ways, typename Tag>
+void checkpointPutCache(CheckpointWriter &writer, const CacheLevel<Payload, Ways, Tag> &cache)
+{
+    checkpointPutVector(writer, cache.tags);
+    checkpointPutVector(writer, cache.valid);
+    checkpointPutVector(writer, cache.dirty);
+    checkpointPutVector(writer, cache.prefetched);
+    for (const Payload &payload : cache.payload)
+    {
+        checkpointPutPayload(writer, payload);
+    }
+    checkpointPutReplacement(writer, cache.replacement);
+}
+
+// The cache is already initialized with the checkpoint's shape.
+template <typename Payload, int Ways, typename Tag>
+void checkpointGetCache(CheckpointReader &reader, CacheLevel<Payload, Ways, Tag> &cache)
+{
+    size_t lines = cache.tags.size();
+    checkpointGetVector(reader, cache.tags);
+    checkpointGetVector(reader, cache.valid);
+    checkpointGetVector(reader, cache.dirty);
+    checkpointGetVector(reader, cache.prefetched);
+    if (cache.tags.size() != lines || cache.valid.size() != lines || cache.dirty.size() != lines || cache.prefetched.size() != lines)
+    {
+        reader.ok = false;
+        return;
+    }
+    for (Payload &payload : cache.payload)
+    {
+        checkpointGetPayload(reader, payload);
+    }
+    checkpointGetReplacement(reader, cache.replacement);
+}
+
+// Unordered containers are written sorted so equal states give equal files.
+void checkpointPutLines(CheckpointWriter &writer, const unordered_set<uint64_t> &lines)
+{
+    vector<uint64_t> sorted(lines.begin(), lines.end());
+    sort(sorted.begin(), sorted.end());
+    checkpointPutVector(writer, sorted);
+}
+
+template <typename Value>
+void checkpointPutLineMap(CheckpointWriter &writer, const unordered_map<uint64_t, Value> &lines)
+{
+    vector<pair<uint64_t, Value> > sorted(lines.begin(), lines.end());
+    sort(sorted.begin(), sorted.end());
+    checkpointPut(writer, sorted.size());
+    for (const auto &line : sorted)
+    {
+        checkpointPut(writer, line.first);
+        checkpointPut(writer, static_cast<uint64_t>(line.second));
+    }
+}
+
+template <typename Value>
+void checkpointGetLineMap(CheckpointReader &reader, unordered_map<uint64_t, Value> &lines)
+{
+    lines.clear();
+    uint64_t count = checkpointGet(reader);
+    if (!reader.ok || count > (reader.bytes.size() - reader.pos) / 16)
+    {
+        reader.ok = false;
+        return;
+    }
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t line = checkpointGet(reader);
+        lines[line] = static_cast<Value>(checkpointGet(reader));
+    }
+}
+
+void checkpointPutPages(CheckpointWriter &writer, const vector<Page> &pages)
+{
+    checkpointPut(writer, pages.size());
+    for (const Page &page : pages)
+    {
+        checkpointPut(writer, page.dirty);
+        checkpointPut(writer, static_cast<uint64_t>(static_cast<int64_t>(page.physicalPage)));
+        checkpointPut(writer, static_cast<uint64_t>(static_cast<int64_t>(page.index)));
+        checkpointPut(writer, static_cast<uint64_t>(page.virtualPage));
+        checkpointPut(writer, page.valid);
+    }
+}
+
+// The pages are already sized from the configuration; index is rebuilt from them.
+void checkpointGetPages(CheckpointReader &reader, vector<Page> &pages, PageIndex &index)
+{
+    if (checkpointGet(reader) != pages.size())
+    {
+        reader.ok = false;
+    }
+    for (size_t frame = 0; frame < pages.size(); frame++)
+    {
+        Page &page = pages[frame];
+        page.dirty = checkpointGet(reader) != 0;
+        page.physicalPage = static_cast<int>(static_cast<int64_t>(checkpointGet(reader)));
+        page.index = static_cast<int>(static_cast<int64_t>(checkpointGet(reader)));
+        page.virtualPage = static_cast<int64_t>(checkpointGet(reader));
+        page.valid = static_cast<int>(checkpointGet(reader));
+        if (page.valid)
+        {
+            pageIndexInsert(index, page.virtualPage, static_cast<int>(frame));
+        }
+    }
+}
+
+void checkpointPutPrefetcher(CheckpointWriter &writer, const Prefetcher &prefetcher)
+{
+    checkpointPut(writer, prefetcher.type);
+    checkpointPut(writer, prefetcher.strideTable.size());
+    for (const StrideEntry &entry : prefetcher.strideTable)
+    {
+        checkpointPut(writer, static_cast<uint64_t>(entry.page));
+        checkpointPut(writer, entry.lastAddress);
+        checkpointPut(writer, static_cast<uint64_t>(entry.stride));
+        checkpointPut(writer, entry.confidence);
+    }
+    checkpointPut(writer, prefetcher.streams.size());
+    for (const StreamEntry &entry : prefetcher.streams)
+    {
+        checkpointPut(writer, entry.valid);
+        checkpointPut(writer, static_cast<uint64_t>(entry.lastLine));
+        checkpointPut(writer, static_cast<uint64_t>(static_cast<int64_t>(entry.direction)));
+        checkpointPut(writer, entry.confidence);
+    }
+    checkpointPut(writer, prefetcher.nextStream);
+    checkpointPutVector(writer, prefetcher.readyCycle);
+    checkpointPutLines(writer, prefetcher.evictedLines);
+    for (uint64_t PrefetchStats::*count : PREFETCH_COUNTERS)
+    {
+        checkpointPut(writer, prefetcher.counts.*count);
+    }
+}
+
+// Keeps the tables, type and degree of prefetcher as initialized from the configuration;
+// the caller decides whether the loaded state applies.
+void checkpointGetPrefetcher(CheckpointReader &reader, Prefetcher &prefetcher)
+{
+    prefetcher.type = static_cast<PrefetcherType>(checkpointGet(reader));
+    uint64_t strideEntries = checkpointGet(reader);
+    if (!reader.ok || strideEntries > static_cast<uint64_t>(PREFETCH_STRIDE_ENTRIES))
+    {
+        reader.ok = false;
+        return;
+    }
+    prefetcher.strideTable.resize(strideEntries);
+    for (StrideEntry &entry : prefetcher.strideTable)
+    {
+        entry.page = static_cast<int64_t>(checkpointGet(reader));
+        entry.lastAddress = checkpointGet(reader);
+        entry.stride = static_cast<int64_t>(checkpointGet(reader));
+        entry.confidence = static_cast<int>(checkpointGet(reader));
+    }
+    uint64_t streams = checkpointGet(reader);
+    if (!reader.ok || streams > static_cast<uint64_t>(PREFETCH_STREAMS))
+    {
+        reader.ok = false;
+        return;
+    }
+    prefetcher.streams.resize(streams);
+    for (StreamEntry &entry : prefetcher.streams)
+    {
+        entry.valid = checkpointGet(reader) != 0;
+        entry.lastLine = static_cast<int64_t>(checkpointGet(reader));
+        entry.direction = static_cast<int>(static_cast<int64_t>(checkpointGet(reader)));
+        entry.confidence = static_cast<int>(checkpointGet(reader));
+    }
+    prefetcher.nextStream = static_cast<int>(checkpointGet(reader));
+    checkpointGetVector(reader, prefetcher.readyCycle);
+    vector<uint64_t> evictedLines;
+    checkpointGetVector(reader, evictedLines);
+    prefetcher.evictedLines = unordered_set<uint64_t>(evictedLines.begin(), evictedLines.end());
+    for (uint64_t PrefetchStats::*count : PREFETCH_COUNTERS)
+    {
+        prefetcher.counts.*count = checkpointGet(reader);
+    }
+}
+
+// Takes a loaded prefetcher if the configuration uses the same type. Otherwise the
+// configured one starts cold and the cache forgets which lines were prefetched.
+template <typename Payload, int Ways, typename Tag>
+void restorePrefetcher(Prefetcher &configured, const Prefetcher &loaded, CacheLevel<Payload, Ways, Tag> &cache)
+{
+    if (loaded.type == configured.type && loaded.readyCycle.size() == configured.readyCycle.size())
+    {
+        int degree = configured.degree;
+        int pageShift = configured.pageShift;
+        configured = loaded;
+        configured.degree = degree;
+        configured.pageShift = pageShift;
+    }
+    else
+    {
+        cache.prefetched.assign(cache.prefetched.size(), 0);
+    }
+}
+
+// Everything a checkpoint must agree on with the configuration restoring it. Latencies
+// and prefetchers are left out, so experiments may vary them from one checkpoint.
+vector<int64_t> configurationShape(const Configuration &config)
+{
+    vector<int64_t> shape = {
+        config.numCores,
+        config.dtlbConfig.numSets, config.dtlbConfig.setSize, config.dtlbConfig.policy,
+        config.ptConfig.numVirtualPages, config.ptConfig.numPhysicalPages, config.ptConfig.pageSize, config.ptConfig.policy,
+        config.ptConfig.levels, config.ptConfig.walkCacheEntries,
+        config.ptConfig.hugePages[0].numPages, config.ptConfig.hugePages[0].tlbSets, config.ptConfig.hugePages[0].tlbSetSize,
+        config.ptConfig.hugePages[1].numPages, config.ptConfig.hugePages[1].tlbSets, config.ptConfig.hugePages[1].tlbSetSize,
+        config.dcConfig.numSets, config.dcConfig.setSize, config.dcConfig.lineSize, config.dcConfig.writeThroughOrNoWriteAllocate, config.dcConfig.policy,
+        config.l2Config.numSets, config.l2Config.setSize, config.l2Config.lineSize, config.l2Config.policy,
+        config.useVirtualAddresses, config.useTLB, config.useL2Cache,
+    };
+    for (const HugePageRegion &region : config.ptConfig.hugePageRegions)
+    {
+        shape.push_back(static_cast<int64_t>(region.start));
+        shape.push_back(static_cast<int64_t>(region.end));
+        shape.push_back(region.pageSize);
+    }
+    return shape;
+}
+
+void Simulator::resetStatistics()
+{
+    // Prefetches still in flight stay in flight relative to the restarted clock
+    uint64_t now = cacheCycles();
+    for (CoreState &core : cores)
+    {
+        for (uint64_t CoreState::*count : CORE_COUNTERS)
+        {
+            core.*count = 0;
+        }
+        core.prefetcher.counts = PrefetchStats();
+        for (uint64_t &ready : core.prefetcher.readyCycle)
+        {
+            ready = ready > now ? ready - now : 0;
+        }
+    }
+    l2Prefetcher.counts = PrefetchStats();
+    for (uint64_t &ready : l2Prefetcher.readyCycle)
+    {
+        ready = ready > now ? ready - now : 0;
+    }
+    for (uint64_t Simulator::*count : SIMULATOR_COUNTERS)
+    {
+        this->*count = 0;
+    }
+    for (uint64_t Simulator::*cycles : SIMULATOR_CYCLES)
+    {
+        this->*cycles = 0;
+    }
+    for (uint64_t Simulator::*count : SIMULATOR_WALK_COUNTERS)
+    {
+        this->*count = 0;
+    }
+    walkCacheHits.assign(walkCacheHits.size(), 0);
+    dtlbSizeHits.assign(dtlbSizeHits.size(), 0);
+    dtlbSizeMisses.assign(dtlbSizeMisses.size(), 0);
+    pageSizeFaults.assign(pageSizeFaults.size(), 0);
+    falseSharingLines.clear();
+}
+
+bool Simulator::saveCheckpoint(const string &filename, uint64_t traceOffset) const
+{
+    CheckpointWriter writer;
+    writer.bytes.insert(writer.bytes.end(), CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + sizeof(CHECKPOINT_MAGIC));
+    checkpointPut(writer, CHECKPOINT_VERSION);
+    checkpointPutVector(writer, configurationShape(config));
+    checkpointPut(writer, traceOffset);
+
+    for (uint64_t Simulator::*count : SIMULATOR_COUNTERS)
+    {
+        checkpointPut(writer, this->*count);
+    }
+    for (uint64_t Simulator::*cycles : SIMULATOR_CYCLES)
+    {
+        checkpointPut(writer, this->*cycles);
+    }
+    for (uint64_t Simulator::*count : SIMULATOR_WALK_COUNTERS)
+    {
+        checkpointPut(writer, this->*count);
+    }
+    checkpointPut(writer, static_cast<uint64_t>(static_cast<int64_t>(currenPhysicalPageAddress)));
+    checkpointPut(writer, trace);
+    checkpointPutLineMap(writer, falseSharingLines);
+
+    checkpointPutPages(writer, pageTableList);
+    checkpointPutReplacement(writer, pageTableReplacement);
+    checkpointPutLineMap(writer, pageTableNodes);
+    checkpointPutVector(writer, walkCacheHits);
+    checkpointPutVector(writer, dtlbSizeHits);
+    checkpointPutVector(writer, dtlbSizeMisses);
+    checkpointPutVector(writer, pageSizeFaults);
+    for (const HugePageFrames &frames : hugeFrames)
+    {
+        checkpointPut(writer, static_cast<uint64_t>(static_cast<int64_t>(frames.lastFrame)));
+        checkpointPutPages(writer, frames.pages);
+        if (!frames.pages.empty())
+        {
+            checkpointPutReplacement(writer, frames.replacement);
+        }
+    }
+
+    for (const CoreState &core : cores)
+    {
+        checkpointPutCache(writer, core.dtlb);
+        for (const CacheLevel<int, 0, int64_t> &tlb : core.hugeTLBs)
+        {
+            checkpointPutCache(writer, tlb);
+        }
+        for (const PageWalkCache &walkCache : core.walkCaches)
+        {
+            checkpointPutCache(writer, walkCache);
+        }
+        checkpointPutCache(writer, core.dataCache);
+        checkpointPutPrefetcher(writer, core.prefetcher);
+        checkpointPutLineMap(writer, core.invalidatedLines);
+        for (uint64_t CoreState::*count : CORE_COUNTERS)
+        {
+            checkpointPut(writer, core.*count);
+        }
+    }
+    checkpointPutCache(writer, l2Cache);
+    checkpointPutPrefetcher(writer, l2Prefetcher);
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr || fwrite(writer.bytes.data(), 1, writer.bytes.size(), file) != writer.bytes.size())
+    {
+        cerr << "Error: Unable to write checkpoint file " << filename << "." << endl;
+        if (file != nullptr)
+            fclose(file);
+        return false;
+    }
+    return fclose(file) == 0;
+}
+
+bool Simulator::loadCheckpoint(const string &filename, uint64_t &traceOffset)
+{
+    CheckpointReader reader;
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+    {
+        cerr << "Error: Unable to open checkpoint file " << filename << "." << endl;
+        return false;
+    }
+    char chunk[1 << 16];
+    size_t bytesRead;
+    while ((bytesRead = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        reader.bytes.insert(reader.bytes.end(), chunk, chunk + bytesRead);
+    }
+    fclose(file);
+
+    if (reader.bytes.size() < sizeof(CHECKPOINT_MAGIC) || memcmp(reader.bytes.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+    {
+        cerr << "Error: " << filename << " is not a checkpoint file." << endl;
+        return false;
+    }
+    reader.pos = sizeof(CHECKPOINT_MAGIC);
+    uint64_t version = checkpointGet(reader);
+    if (version != CHECKPOINT_VERSION)
+    {
+        cerr << "Error: Unsupported checkpoint version " << version << "." << endl;
+        return false;
+    }
+    vector<int64_t> shape;
+    checkpointGetVector(reader, shape);
+    if (shape != configurationShape(config))
+    {
+        cerr << "Error: Checkpoint " << filename << " was taken with different cache, TLB, page table or core settings." << endl;
+        return false;
+    }
+    uint64_t offset = checkpointGet(reader);
+
+    // Loaded into a copy, so a damaged file leaves this simulator as it was
+    Simulator loaded(*this);
+    loaded.initializeMemoryHierarchy();
+    for (uint64_t Simulator::*count : SIMULATOR_COUNTERS)
+    {
+        loaded.*count = checkpointGet(reader);
+    }
+    for (uint64_t Simulator::*cycles : SIMULATOR_CYCLES)
+    {
+        loaded.*cycles = checkpointGet(reader);
+    }
+    for (uint64_t Simulator::*count : SIMULATOR_WALK_COUNTERS)
+    {
+        loaded.*count = checkpointGet(reader);
+    }
+    loaded.currenPhysicalPageAddress = static_cast<int>(static_cast<int64_t>(checkpointGet(reader)));
+    loaded.trace = checkpointGet(reader);
+    checkpointGetLineMap(reader, loaded.falseSharingLines);
+
+    checkpointGetPages(reader, loaded.pageTableList, loaded.pageIndex);
+    checkpointGetReplacement(reader, loaded.pageTableReplacement);
+    checkpointGetLineMap(reader, loaded.pageTableNodes);
+    size_t walkCacheLevels = loaded.walkCacheHits.size();
+    checkpointGetVector(reader, loaded.walkCacheHits);
+    checkpointGetVector(reader, loaded.dtlbSizeHits);
+    checkpointGetVector(reader, loaded.dtlbSizeMisses);
+    checkpointGetVector(reader, loaded.pageSizeFaults);
+    if (loaded.walkCacheHits.size() != walkCacheLevels || loaded.dtlbSizeHits.size() != HUGE_PAGE_SIZES + 1 ||
+        loaded.dtlbSizeMisses.size() != HUGE_PAGE_SIZES + 1 || loaded.pageSizeFaults.size() != HUGE_PAGE_SIZES + 1)
+    {
+        reader.ok = false;
+    }
+    for (HugePageFrames &frames : loaded.hugeFrames)
+    {
+        frames.lastFrame = static_cast<int>(static_cast<int64_t>(checkpointGet(reader)));
+        checkpointGetPages(reader, frames.pages, frames.index);
+        if (!frames.pages.empty())
+        {
+            checkpointGetReplacement(reader, frames.replacement);
+        }
+    }
+
+    for (CoreState &core : loaded.cores)
+    {
+        checkpointGetCache(reader, core.dtlb);
+        for (CacheLevel<int, 0, int64_t> &tlb : core.hugeTLBs)
+        {
+            checkpointGetCache(reader, tlb);
+        }
+        for (PageWalkCache &walkCache : core.walkCaches)
+        {
+            checkpointGetCache(reader, walkCache);
+        }
+        checkpointGetCache(reader, core.dataCache);
+        Prefetcher prefetcher;
+        checkpointGetPrefetcher(reader, prefetcher);
+        restorePrefetcher(core.prefetcher, prefetcher, core.dataCache);
+        checkpointGetLineMap(reader, core.invalidatedLines);
+        for (uint64_t CoreState::*count : CORE_COUNTERS)
+        {
+            core.*count = checkpointGet(reader);
+        }
+    }
+    checkpointGetCache(reader, loaded.l2Cache);
+    Prefetcher prefetcher;
+    checkpointGetPrefetcher(reader, prefetcher);
+    restorePrefetcher(loaded.l2Prefetcher, prefetcher, loaded.l2Cache);
+
+    if (!reader.ok || reader.pos != reader.bytes.size())
+    {
+        cerr << "Error: Checkpoint file " << filename << " is damaged." << endl;
+        return false;
+    }
+    *this = loaded;
+    traceOffset = offset;
+    return true;
+}
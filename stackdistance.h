@@ -0,0 +1,204 @@
+#ifndef STACKDISTANCE_H
+#define STACKDISTANCE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Mattson stack-distance analysis for set-associative LRU caches.
+//
+// For a cache with S sets, the stack distance of an access is the number of distinct
+// lines of the same set used since the previous access to its line. An A-way LRU cache
+// with S sets hits exactly the accesses whose distance is below A, so one pass gives the
+// hit ratio of every associativity for that set count. A StackDistanceProfile keeps one
+// analyzer per power-of-two set count, which covers every capacity of the form
+// sets * ways * lineSize.
+//
+// Each set counts distinct lines with a Fenwick tree over its own access clock: the
+// previous use of every resident line holds a 1, so the distance is a range sum, and
+// each access costs O(log n). When a set's clock reaches the end of its tree the live
+// markers are renumbered, keeping memory proportional to the number of distinct lines
+// rather than to the trace length.
+
+const int STACK_DISTANCE_BUCKETS = 64; // bucket b holds distances in [2^(b-1), 2^b)
+const uint32_t STACK_MIN_TREE_SIZE = 64;
+
+struct SetStack
+{
+    std::unordered_map<uint64_t, uint32_t> lastUse; // line -> clock of its previous access
+    std::vector<int> tree;                          // Fenwick tree, 1-based
+    uint32_t clock = 0;
+};
+
+struct StackDistanceAnalyzer
+{
+    int numSets = 1;
+    std::vector<SetStack> sets;
+    uint64_t histogram[STACK_DISTANCE_BUCKETS] = {};
+    uint64_t coldMisses = 0;
+    uint64_t accesses = 0;
+};
+
+struct StackDistanceProfile
+{
+    int lineSize = 1;
+    std::vector<StackDistanceAnalyzer> analyzers; // set counts 1, 2, 4, ...
+};
+
+inline void fenwickAdd(std::vector<int> &tree, uint32_t index, int delta)
+{
+    for (; index < tree.size(); index += index & (~index + 1))
+    {
+        tree[index] += delta;
+    }
+}
+
+inline int fenwickSum(const std::vector<int> &tree, uint32_t index)
+{
+    int sum = 0;
+    for (; index > 0; index -= index & (~index + 1))
+    {
+        sum += tree[index];
+    }
+    return sum;
+}
+
+// Renumbers the live markers of a set as 1..k and rebuilds its tree with room to grow.
+inline void compactSetStack(SetStack &stack)
+{
+    std::vector<std::pair<uint32_t, uint64_t> > live;
+    live.reserve(stack.lastUse.size());
+    for (const auto &entry : stack.lastUse)
+    {
+        live.push_back(std::make_pair(entry.second, entry.first));
+    }
+    std::sort(live.begin(), live.end());
+
+    uint32_t size = std::max<uint32_t>(STACK_MIN_TREE_SIZE, 2 * static_cast<uint32_t>(live.size()));
+    stack.tree.assign(size + 1, 0);
+    for (uint32_t i = 0; i < live.size(); i++)
+    {
+        stack.lastUse[live[i].second] = i + 1;
+    }
+    // A tree holding a 1 at every position up to k: node i covers (i - lowbit(i), i]
+    uint32_t count = static_cast<uint32_t>(live.size());
+    for (uint32_t i = 1; i <= size; i++)
+    {
+        uint32_t start = i - (i & (~i + 1));
+        stack.tree[i] = static_cast<int>(std::min(i, count) - std::min(start, count));
+    }
+    stack.clock = count;
+}
+
+inline int stackDistanceBucket(uint64_t distance)
+{
+    int bucket = 0;
+    while (distance != 0)
+    {
+        bucket++;
+        distance >>= 1;
+    }
+    return bucket;
+}
+
+inline void initStackDistanceProfile(StackDistanceProfile &profile, int lineSize, int maxSets)
+{
+    profile.lineSize = lineSize;
+    profile.analyzers.clear();
+    for (int sets = 1; sets <= maxSets; sets *= 2)
+    {
+        StackDistanceAnalyzer analyzer;
+        analyzer.numSets = sets;
+        analyzer.sets.resize(sets);
+        profile.analyzers.push_back(analyzer);
+    }
+}
+
+inline void recordStackAccess(StackDistanceAnalyzer &analyzer, uint64_t line)
+{
+    SetStack &stack = analyzer.sets[line & (analyzer.numSets - 1)];
+    if (stack.clock + 1 >= stack.tree.size())
+    {
+        compactSetStack(stack);
+    }
+    uint32_t now = ++stack.clock;
+    analyzer.accesses++;
+
+    auto found = stack.lastUse.find(line);
+    if (found == stack.lastUse.end())
+    {
+        analyzer.coldMisses++;
+        stack.lastUse.emplace(line, now);
+    }
+    else
+    {
+        uint32_t previous = found->second;
+        uint64_t distance = fenwickSum(stack.tree, now - 1) - fenwickSum(stack.tree, previous);
+        analyzer.histogram[stackDistanceBucket(distance)]++;
+        fenwickAdd(stack.tree, previous, -1);
+        found->second = now;
+    }
+    fenwickAdd(stack.tree, now, 1);
+}
+
+// line is the address with the line offset removed.
+inline void recordStackAccess(StackDistanceProfile &profile, uint64_t line)
+{
+    for (StackDistanceAnalyzer &analyzer : profile.analyzers)
+    {
+        recordStackAccess(analyzer, line);
+    }
+}
+
+// Misses of an LRU cache with the analyzer's set count and ways a power of two.
+inline uint64_t stackMisses(const StackDistanceAnalyzer &analyzer, uint64_t ways)
+{
+    // distance < ways hits; with ways = 2^k that is every bucket up to k
+    int firstMissBucket = stackDistanceBucket(ways);
+    uint64_t misses = analyzer.coldMisses;
+    for (int bucket = firstMissBucket; bucket < STACK_DISTANCE_BUCKETS; bucket++)
+    {
+        misses += analyzer.histogram[bucket];
+    }
+    return misses;
+}
+
+// Prints the miss ratio of every power-of-two set count and associativity, up to the
+// associativity past which only cold misses remain. The configured shape is marked '*'.
+inline void printMissRatioCurve(std::ostream &out, const char *name, const StackDistanceProfile &profile, int configuredSets, int configuredWays)
+{
+    if (profile.analyzers.empty())
+    {
+        return;
+    }
+    const StackDistanceAnalyzer &fullyAssociative = profile.analyzers[0];
+    out << std::endl
+        << name << " miss ratio curve (" << profile.lineSize << " byte lines, " << fullyAssociative.accesses << " accesses, "
+        << fullyAssociative.coldMisses << " cold misses)" << std::endl
+        << std::endl;
+    out << "    sets     ways  capacity (bytes)  miss ratio" << std::endl;
+    for (const StackDistanceAnalyzer &analyzer : profile.analyzers)
+    {
+        int lastBucket = 0;
+        for (int bucket = 0; bucket < STACK_DISTANCE_BUCKETS; bucket++)
+        {
+            if (analyzer.histogram[bucket] != 0)
+                lastBucket = bucket;
+        }
+        for (uint64_t ways = 1; stackDistanceBucket(ways) <= lastBucket + 1; ways *= 2)
+        {
+            uint64_t misses = stackMisses(analyzer, ways);
+            double ratio = analyzer.accesses > 0 ? static_cast<double>(misses) / analyzer.accesses : 0;
+            bool configured = analyzer.numSets == configuredSets && static_cast<int>(ways) == configuredWays;
+            out << std::right << std::setw(8) << analyzer.numSets << " " << std::setw(8) << ways << " "
+                << std::setw(17) << ways * analyzer.numSets * profile.lineSize << "  "
+                << std::fixed << std::setprecision(6) << ratio << (configured ? " *" : "") << std::endl;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+
+#include "tracefile.h"
+
+using namespace std;
+
+// Converts a text trace (R:c84 per line) into the binary trace format read by memhier.
+// Binary input is accepted too, so the tool can also switch a trace between the
+// fixed-size and delta encodings.
+
+void printUsage(const char *program)
+{
+    cerr << "Usage: " << program << " [-d] [-c] <input trace> <output trace>" << endl;
+    cerr << "  -d  delta encode addresses (variable-length records)" << endl;
+    cerr << "  -c  keep the core id of every record (multi-core traces)" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t flags = 0;
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-')
+    {
+        if (strcmp(argv[arg], "-d") == 0)
+        {
+            flags |= TRACE_FLAG_DELTA;
+        }
+        else if (strcmp(argv[arg], "-c") == 0)
+        {
+            flags |= TRACE_FLAG_CORES;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        arg++;
+    }
+    if (argc - arg != 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    TraceReader reader;
+    if (!openTraceFile(reader, argv[arg]))
+    {
+        return 1;
+    }
+    // Core ids already recorded in a binary trace are kept
+    flags |= reader.flags & TRACE_FLAG_CORES;
+    TraceWriter writer;
+    if (!openTraceWriter(writer, argv[arg + 1], flags))
+    {
+        closeTraceFile(reader);
+        return 1;
+    }
+
+    TraceRecord record;
+    while (nextTraceRecord(reader, record))
+    {
+        writeTraceRecord(writer, record);
+    }
+    closeTraceFile(reader);
+    closeTraceWriter(writer);
+
+    cout << "Wrote " << writer.recordCount << " records to " << argv[arg + 1] << endl;
+    return 0;
+}
@@ -0,0 +1,495 @@
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "profile.h"
+
+// Trace input for the simulator. Two formats are accepted:
+//
+//  - text: one "R:c84" / "W:1a2c" record per line (the original trace.dat format),
+//    optionally prefixed with the decimal id of the issuing core: "3:W:1a2c"
+//  - binary: a 16 byte header followed by packed records
+//
+// Binary header (all fields little-endian):
+//   bytes 0-3   magic "MHTR"
+//   bytes 4-5   format version (TRACE_BINARY_VERSION)
+//   bytes 6-7   flags (TRACE_FLAG_DELTA, TRACE_FLAG_CORES)
+//   bytes 8-15  number of records, checked against the records read
+//
+// Each record packs the access type into bit 0 (1 = write) and the address into
+// bits 1-63. Without TRACE_FLAG_DELTA every record is a fixed 8 byte word. With it,
+// records hold the zigzag encoded difference from the previous address instead,
+// written as a LEB128 varint, which keeps strided and sequential traces to 1-2
+// bytes per access. With TRACE_FLAG_CORES every record is preceded by the core id
+// as a LEB128 varint; without it all records belong to core 0.
+
+const size_t TRACE_BUFFER_SIZE = 1 << 20;
+const char TRACE_BINARY_MAGIC[4] = {'M', 'H', 'T', 'R'};
+const uint16_t TRACE_BINARY_VERSION = 1;
+const uint16_t TRACE_FLAG_DELTA = 1;
+const uint16_t TRACE_FLAG_CORES = 2;
+const uint16_t TRACE_KNOWN_FLAGS = TRACE_FLAG_DELTA | TRACE_FLAG_CORES;
+const size_t TRACE_HEADER_SIZE = 16;
+const size_t TRACE_RECORD_SIZE = 8;
+const size_t TRACE_MAX_VARINT_SIZE = 10;
+
+enum TraceFormat
+{
+    TRACE_TEXT,
+    TRACE_BINARY
+};
+
+struct TraceRecord
+{
+    char accessType;
+    uint64_t address;
+    int core = 0;
+};
+
+struct TraceReader
+{
+    FILE *file = nullptr;
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t end = 0;
+    bool eof = true;
+    bool skipLine = false;
+    TraceFormat format = TRACE_TEXT;
+    uint16_t flags = 0;
+    uint64_t recordCount = 0;
+    uint64_t recordsRead = 0;
+    uint64_t previousAddress = 0;
+};
+
+struct TraceWriter
+{
+    FILE *file = nullptr;
+    std::vector<unsigned char> buffer;
+    TraceFormat format = TRACE_BINARY;
+    uint16_t flags = 0;
+    uint64_t recordCount = 0;
+    uint64_t previousAddress = 0;
+};
+
+inline void storeLittleEndian(unsigned char *bytes, uint64_t value, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+inline uint64_t loadLittleEndian(const unsigned char *bytes, int size)
+{
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--)
+    {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+inline uint64_t encodeTraceRecord(const TraceRecord &record)
+{
+    return (record.address << 1) | (record.accessType == 'W' ? 1 : 0);
+}
+
+inline void decodeTraceRecord(uint64_t word, TraceRecord &record)
+{
+    record.accessType = (word & 1) ? 'W' : 'R';
+    record.address = word >> 1;
+}
+
+// Moves the unread tail of the block to the front and reads more of the file behind it.
+inline void refillTraceBuffer(TraceReader &reader)
+{
+    size_t remaining = reader.end - reader.pos;
+    memmove(reader.buffer.data(), reader.buffer.data() + reader.pos, remaining);
+    reader.pos = 0;
+    reader.end = remaining;
+    size_t bytesRead = fread(reader.buffer.data() + remaining, 1, reader.buffer.size() - remaining, reader.file);
+    reader.end += bytesRead;
+    if (bytesRead == 0)
+        reader.eof = true;
+}
+
+inline bool openTraceFile(TraceReader &reader, const std::string &traceFile)
+{
+    reader.file = fopen(traceFile.c_str(), "rb");
+    reader.buffer.resize(TRACE_BUFFER_SIZE);
+    reader.pos = 0;
+    reader.end = 0;
+    reader.eof = false;
+    reader.skipLine = false;
+    reader.format = TRACE_TEXT;
+    reader.flags = 0;
+    reader.recordCount = 0;
+    reader.recordsRead = 0;
+    reader.previousAddress = 0;
+    if (reader.file == nullptr)
+    {
+        std::cerr << "Error: Unable to open trace file." << std::endl;
+        reader.eof = true;
+        return false;
+    }
+
+    refillTraceBuffer(reader);
+    const unsigned char *header = reinterpret_cast<const unsigned char *>(reader.buffer.data());
+    if (reader.end >= TRACE_HEADER_SIZE && memcmp(header, TRACE_BINARY_MAGIC, sizeof(TRACE_BINARY_MAGIC)) == 0)
+    {
+        uint16_t version = static_cast<uint16_t>(loadLittleEndian(header + 4, 2));
+        if (version != TRACE_BINARY_VERSION)
+        {
+            std::cerr << "Error: Unsupported binary trace version " << version << "." << std::endl;
+            reader.pos = reader.end;
+            reader.eof = true;
+            return false;
+        }
+        reader.format = TRACE_BINARY;
+        reader.flags = static_cast<uint16_t>(loadLittleEndian(header + 6, 2));
+        if (reader.flags & ~TRACE_KNOWN_FLAGS)
+        {
+            std::cerr << "Error: Unsupported binary trace flags " << reader.flags << "." << std::endl;
+            reader.pos = reader.end;
+            reader.eof = true;
+            return false;
+        }
+        reader.recordCount = loadLittleEndian(header + 8, 8);
+        reader.pos = TRACE_HEADER_SIZE;
+    }
+    return true;
+}
+
+inline void closeTraceFile(TraceReader &reader)
+{
+    if (reader.file != nullptr)
+    {
+        fclose(reader.file);
+        reader.file = nullptr;
+    }
+}
+
+inline int hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Parses one "R:c84" or "3:R:c84" style line in place. Blank lines yield no record.
+inline bool parseTraceLine(const char *line, const char *lineEnd, TraceRecord &record)
+{
+    while (line < lineEnd && isspace(static_cast<unsigned char>(*line)))
+        line++;
+    if (line == lineEnd)
+        return false;
+
+    record.core = 0;
+    if (isdigit(static_cast<unsigned char>(*line)))
+    {
+        while (line < lineEnd && isdigit(static_cast<unsigned char>(*line)))
+            record.core = record.core * 10 + (*line++ - '0');
+        while (line < lineEnd && (*line == ':' || *line == ' ' || *line == '\t'))
+            line++;
+        if (line == lineEnd)
+            return false;
+    }
+
+    record.accessType = *line++;
+    while (line < lineEnd && (*line == ':' || *line == ' ' || *line == '\t'))
+        line++;
+    if (lineEnd - line > 1 && line[0] == '0' && (line[1] == 'x' || line[1] == 'X'))
+        line += 2;
+
+    uint64_t address = 0;
+    int digit;
+    while (line < lineEnd && (digit = hexDigitValue(*line)) >= 0)
+    {
+        address = (address << 4) | static_cast<uint64_t>(digit);
+        line++;
+    }
+    record.address = address;
+    return true;
+}
+
+inline bool nextTextTraceRecord(TraceReader &reader, TraceRecord &record)
+{
+    while (true)
+    {
+        char *start = reader.buffer.data() + reader.pos;
+        char *end = reader.buffer.data() + reader.end;
+        char *newline = static_cast<char *>(memchr(start, '\n', end - start));
+        if (reader.skipLine)
+        {
+            // Dropping the tail of an over-long line up to its newline
+            if (newline != nullptr)
+            {
+                reader.pos = newline - reader.buffer.data() + 1;
+                reader.skipLine = false;
+                continue;
+            }
+            reader.pos = reader.end;
+            if (reader.eof)
+                return false;
+            refillTraceBuffer(reader);
+            continue;
+        }
+        if (newline != nullptr)
+        {
+            reader.pos = newline - reader.buffer.data() + 1;
+            if (parseTraceLine(start, newline, record))
+                return true;
+            continue;
+        }
+        if (reader.eof)
+        {
+            reader.pos = reader.end;
+            return start < end && parseTraceLine(start, end, record);
+        }
+        if (reader.end - reader.pos == reader.buffer.size())
+        {
+            // Line longer than a whole block; parse what we have and drop the rest
+            reader.pos = reader.end;
+            reader.skipLine = true;
+            if (parseTraceLine(start, end, record))
+                return true;
+            continue;
+        }
+        refillTraceBuffer(reader);
+    }
+}
+
+// Decodes the LEB128 varint at the read position. Returns false if the data ends first.
+inline bool readTraceVarint(TraceReader &reader, uint64_t &value)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(reader.buffer.data()) + reader.pos;
+    size_t available = reader.end - reader.pos;
+    value = 0;
+    size_t length = 0;
+    while (true)
+    {
+        if (length == available || length == TRACE_MAX_VARINT_SIZE)
+            return false;
+        unsigned char byte = bytes[length];
+        value |= static_cast<uint64_t>(byte & 0x7f) << (7 * length);
+        length++;
+        if ((byte & 0x80) == 0)
+            break;
+    }
+    reader.pos += length;
+    return true;
+}
+
+inline bool decodeBinaryTraceRecord(TraceReader &reader, TraceRecord &record)
+{
+    size_t needed = (reader.flags & TRACE_FLAG_DELTA) ? TRACE_MAX_VARINT_SIZE : TRACE_RECORD_SIZE;
+    if (reader.flags & TRACE_FLAG_CORES)
+        needed += TRACE_MAX_VARINT_SIZE;
+    if (reader.end - reader.pos < needed && !reader.eof)
+        refillTraceBuffer(reader);
+
+    record.core = 0;
+    if (reader.flags & TRACE_FLAG_CORES)
+    {
+        uint64_t core;
+        if (!readTraceVarint(reader, core))
+            return false;
+        record.core = static_cast<int>(core);
+    }
+
+    if (!(reader.flags & TRACE_FLAG_DELTA))
+    {
+        if (reader.end - reader.pos < TRACE_RECORD_SIZE)
+            return false;
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(reader.buffer.data()) + reader.pos;
+        decodeTraceRecord(loadLittleEndian(bytes, TRACE_RECORD_SIZE), record);
+        reader.pos += TRACE_RECORD_SIZE;
+        return true;
+    }
+
+    uint64_t value;
+    if (!readTraceVarint(reader, value))
+        return false;
+
+    uint64_t zigzag = value >> 1;
+    int64_t delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+    reader.previousAddress += static_cast<uint64_t>(delta);
+    decodeTraceRecord((reader.previousAddress << 1) | (value & 1), record);
+    return true;
+}
+
+// Counts the records against the header, so a truncated trace does not pass for a shorter one.
+inline bool nextBinaryTraceRecord(TraceReader &reader, TraceRecord &record)
+{
+    if (decodeBinaryTraceRecord(reader, record))
+    {
+        reader.recordsRead++;
+        return true;
+    }
+    if (reader.recordsRead != reader.recordCount)
+    {
+        std::cerr << "Error: The binary trace holds " << reader.recordsRead << " records but its header says " << reader.recordCount << "." << std::endl;
+        // Reported once; later calls see a consistent count
+        reader.recordCount = reader.recordsRead;
+    }
+    return false;
+}
+
+// Returns the next record of the trace, reading the file one block at a time so
+// memory use does not depend on the trace length.
+inline bool nextTraceRecord(TraceReader &reader, TraceRecord &record)
+{
+    PROFILE_SCOPE(PROFILE_PARSE);
+    if (reader.format == TRACE_BINARY)
+        return nextBinaryTraceRecord(reader, record);
+    return nextTextTraceRecord(reader, record);
+}
+
+// Reads past the next count records, e.g. the ones a checkpoint has already simulated.
+// Returns how many there were.
+inline uint64_t skipTraceRecords(TraceReader &reader, uint64_t count)
+{
+    TraceRecord record;
+    uint64_t skipped = 0;
+    while (skipped < count && nextTraceRecord(reader, record))
+    {
+        skipped++;
+    }
+    return skipped;
+}
+
+inline void writeTraceHeader(TraceWriter &writer)
+{
+    unsigned char header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_BINARY_MAGIC, sizeof(TRACE_BINARY_MAGIC));
+    storeLittleEndian(header + 4, TRACE_BINARY_VERSION, 2);
+    storeLittleEndian(header + 6, writer.flags, 2);
+    storeLittleEndian(header + 8, writer.recordCount, 8);
+    fwrite(header, 1, sizeof(header), writer.file);
+}
+
+inline bool openTraceWriter(TraceWriter &writer, const std::string &traceFile, uint16_t flags)
+{
+    writer.file = fopen(traceFile.c_str(), "wb");
+    writer.format = TRACE_BINARY;
+    writer.buffer.clear();
+    writer.buffer.reserve(TRACE_BUFFER_SIZE + 2 * TRACE_MAX_VARINT_SIZE);
+    writer.flags = flags;
+    writer.recordCount = 0;
+    writer.previousAddress = 0;
+    if (writer.file == nullptr)
+    {
+        std::cerr << "Error: Unable to open output trace file." << std::endl;
+        return false;
+    }
+    // The record count is patched in by closeTraceWriter
+    writeTraceHeader(writer);
+    return true;
+}
+
+// Writes the text format instead; TRACE_FLAG_CORES adds the core prefix to every line.
+inline bool openTextTraceWriter(TraceWriter &writer, const std::string &traceFile, uint16_t flags)
+{
+    writer.file = fopen(traceFile.c_str(), "wb");
+    writer.format = TRACE_TEXT;
+    writer.buffer.clear();
+    writer.buffer.reserve(TRACE_BUFFER_SIZE + 32);
+    writer.flags = flags & TRACE_FLAG_CORES;
+    writer.recordCount = 0;
+    writer.previousAddress = 0;
+    if (writer.file == nullptr)
+    {
+        std::cerr << "Error: Unable to open output trace file." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline void flushTraceWriter(TraceWriter &writer)
+{
+    fwrite(writer.buffer.data(), 1, writer.buffer.size(), writer.file);
+    writer.buffer.clear();
+}
+
+inline void writeTraceVarint(TraceWriter &writer, uint64_t value)
+{
+    do
+    {
+        unsigned char byte = value & 0x7f;
+        value >>= 7;
+        writer.buffer.push_back(value != 0 ? (byte | 0x80) : byte);
+    } while (value != 0);
+}
+
+inline void writeTextTraceRecord(TraceWriter &writer, const TraceRecord &record)
+{
+    char line[48];
+    int length;
+    unsigned long long address = record.address;
+    if (writer.flags & TRACE_FLAG_CORES)
+        length = snprintf(line, sizeof(line), "%d:%c:%llx\n", record.core, record.accessType, address);
+    else
+        length = snprintf(line, sizeof(line), "%c:%llx\n", record.accessType, address);
+    writer.buffer.insert(writer.buffer.end(), line, line + length);
+}
+
+inline void writeTraceRecord(TraceWriter &writer, const TraceRecord &record)
+{
+    if (writer.format == TRACE_TEXT)
+    {
+        writeTextTraceRecord(writer, record);
+        writer.recordCount++;
+        if (writer.buffer.size() >= TRACE_BUFFER_SIZE)
+            flushTraceWriter(writer);
+        return;
+    }
+    uint64_t word = encodeTraceRecord(record);
+    if (writer.flags & TRACE_FLAG_CORES)
+    {
+        writeTraceVarint(writer, static_cast<uint64_t>(static_cast<unsigned int>(record.core)));
+    }
+    if (writer.flags & TRACE_FLAG_DELTA)
+    {
+        uint64_t address = word >> 1;
+        int64_t delta = static_cast<int64_t>(address - writer.previousAddress);
+        uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        writer.previousAddress = address;
+        writeTraceVarint(writer, (zigzag << 1) | (word & 1));
+    }
+    else
+    {
+        unsigned char bytes[TRACE_RECORD_SIZE];
+        storeLittleEndian(bytes, word, TRACE_RECORD_SIZE);
+        writer.buffer.insert(writer.buffer.end(), bytes, bytes + TRACE_RECORD_SIZE);
+    }
+    writer.recordCount++;
+    if (writer.buffer.size() >= TRACE_BUFFER_SIZE)
+        flushTraceWriter(writer);
+}
+
+inline void closeTraceWriter(TraceWriter &writer)
+{
+    if (writer.file == nullptr)
+        return;
+    flushTraceWriter(writer);
+    if (writer.format == TRACE_BINARY)
+    {
+        fseek(writer.file, 0, SEEK_SET);
+        writeTraceHeader(writer);
+    }
+    fclose(writer.file);
+    writer.file = nullptr;
+}
+
+#endif
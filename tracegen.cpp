@@ -0,0 +1,106 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+#include "tracefile.h"
+#include "tracegen.h"
+
+using namespace std;
+
+// Writes a synthetic trace (see tracegen.h for the patterns) in the text format, or in
+// the binary format with -b or -d.
+
+void printUsage(const char *program)
+{
+    cerr << "Usage: " << program << " [options] <pattern> <output trace>" << endl;
+    cerr << "  patterns: sequential, strided, random, zipf, chase, mixed" << endl;
+    cerr << "  -n N  number of accesses (default 1000000)" << endl;
+    cerr << "  -f N  footprint in bytes, a power of two (default 16777216)" << endl;
+    cerr << "  -a N  base address, in hex (default 0)" << endl;
+    cerr << "  -s N  stride in bytes for the strided pattern (default 64)" << endl;
+    cerr << "  -w F  fraction of writes (default 0.3)" << endl;
+    cerr << "  -z F  Zipf exponent (default 0.99)" << endl;
+    cerr << "  -c N  spread consecutive accesses over N cores (default 1)" << endl;
+    cerr << "  -r N  random seed (default 1)" << endl;
+    cerr << "  -b    write a binary trace" << endl;
+    cerr << "  -d    write a delta encoded binary trace" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    TraceGenOptions options;
+    uint64_t count = 1000000;
+    bool binary = false;
+    uint16_t flags = 0;
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-')
+    {
+        const char *option = argv[arg];
+        bool hasValue = strlen(option) == 2 && strchr("nfaswzcr", option[1]) != nullptr;
+        if (hasValue && arg + 1 == argc)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char *value = hasValue ? argv[++arg] : "";
+        if (strcmp(option, "-n") == 0)
+            count = strtoull(value, nullptr, 10);
+        else if (strcmp(option, "-f") == 0)
+            options.footprint = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strcmp(option, "-a") == 0)
+            options.base = strtoull(value, nullptr, 16);
+        else if (strcmp(option, "-s") == 0)
+            options.stride = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        else if (strcmp(option, "-w") == 0)
+            options.writeFraction = atof(value);
+        else if (strcmp(option, "-z") == 0)
+            options.zipfExponent = atof(value);
+        else if (strcmp(option, "-c") == 0)
+            options.cores = atoi(value);
+        else if (strcmp(option, "-r") == 0)
+            options.seed = strtoull(value, nullptr, 10);
+        else if (strcmp(option, "-b") == 0)
+            binary = true;
+        else if (strcmp(option, "-d") == 0)
+        {
+            binary = true;
+            flags |= TRACE_FLAG_DELTA;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        arg++;
+    }
+    if (argc - arg != 2 || !parseTracePattern(argv[arg], options.pattern))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    TraceGenerator generator;
+    if (!initTraceGenerator(generator, options))
+    {
+        return 1;
+    }
+    if (options.cores > 1)
+    {
+        flags |= TRACE_FLAG_CORES;
+    }
+    TraceWriter writer;
+    bool opened = binary ? openTraceWriter(writer, argv[arg + 1], flags) : openTextTraceWriter(writer, argv[arg + 1], flags);
+    if (!opened)
+    {
+        return 1;
+    }
+    for (uint64_t i = 0; i < count; i++)
+    {
+        writeTraceRecord(writer, nextGeneratedRecord(generator));
+    }
+    closeTraceWriter(writer);
+
+    cout << "Wrote " << writer.recordCount << " " << tracePatternName(options.pattern) << " records to " << argv[arg + 1] << endl;
+    return 0;
+}
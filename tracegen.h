@@ -0,0 +1,212 @@
+#ifndef TRACEGEN_H
+#define TRACEGEN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tracefile.h"
+
+// Synthetic traces for testing and benchmarking the simulator. Every pattern walks a
+// footprint of a power-of-two number of bytes starting at base:
+//
+//  - sequential: one word after another, wrapping around the footprint
+//  - strided:    every stride bytes, wrapping around the footprint
+//  - random:     uniformly random words
+//  - zipf:       lines chosen with Zipfian popularity (exponent zipfExponent), the
+//                popular lines scattered over the footprint
+//  - chase:      pointer chasing, one line after another along a random cycle through
+//                every line of the footprint
+//  - mixed:      runs of TRACE_GEN_PHASE accesses, each taken from one of the others
+//
+// A writeFraction of the accesses are writes, and consecutive records go to the cores
+// in turn. The random numbers come from splitmix64, so a seed gives the same trace on
+// every platform.
+
+const int TRACE_GEN_LINE = 64;     // bytes per line for the zipf and chase patterns
+const int TRACE_GEN_WORD = 4;      // bytes per access, as ACCESS_BYTES in the simulator
+const int TRACE_GEN_PHASE = 1024;  // accesses per run of one pattern in the mixed pattern
+const uint32_t TRACE_GEN_MAX_FOOTPRINT = 1u << 30;
+
+enum TracePattern
+{
+    PATTERN_SEQUENTIAL,
+    PATTERN_STRIDED,
+    PATTERN_RANDOM,
+    PATTERN_ZIPF,
+    PATTERN_CHASE,
+    PATTERN_MIXED
+};
+
+const char *const TRACE_PATTERN_NAMES[] = {"sequential", "strided", "random", "zipf", "chase", "mixed"};
+const int TRACE_PATTERN_COUNT = 6;
+
+struct TraceGenOptions
+{
+    TracePattern pattern = PATTERN_SEQUENTIAL;
+    uint32_t footprint = 1u << 24;
+    uint64_t base = 0;
+    uint32_t stride = 64;
+    double writeFraction = 0.3;
+    double zipfExponent = 0.99;
+    int cores = 1;
+    uint64_t seed = 1;
+};
+
+struct TraceGenerator
+{
+    TraceGenOptions options;
+    uint64_t randomState = 0;
+    uint64_t generated = 0;
+    uint32_t lines = 0;
+    uint32_t sequentialOffset = 0;
+    uint32_t stridedOffset = 0;
+    std::vector<uint32_t> chaseNext; // line after each line on the cycle
+    uint32_t chaseLine = 0;
+    TracePattern phasePattern = PATTERN_SEQUENTIAL;
+};
+
+inline const char *tracePatternName(TracePattern pattern)
+{
+    return TRACE_PATTERN_NAMES[pattern];
+}
+
+inline bool parseTracePattern(const std::string &name, TracePattern &pattern)
+{
+    for (int i = 0; i < TRACE_PATTERN_COUNT; i++)
+    {
+        if (name == TRACE_PATTERN_NAMES[i])
+        {
+            pattern = static_cast<TracePattern>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline uint64_t nextRandom(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+inline double randomUnit(uint64_t &state)
+{
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline uint32_t randomBelow(uint64_t &state, uint32_t bound)
+{
+    return static_cast<uint32_t>((nextRandom(state) >> 32) * bound >> 32);
+}
+
+inline bool initTraceGenerator(TraceGenerator &generator, const TraceGenOptions &options)
+{
+    uint32_t footprint = options.footprint;
+    if (footprint < static_cast<uint32_t>(TRACE_GEN_LINE) || footprint > TRACE_GEN_MAX_FOOTPRINT || (footprint & (footprint - 1)) != 0)
+    {
+        std::cerr << "Error: The footprint must be a power of two from " << TRACE_GEN_LINE << " bytes to 1 GiB." << std::endl;
+        return false;
+    }
+    if (options.stride == 0 || options.stride % TRACE_GEN_WORD != 0)
+    {
+        std::cerr << "Error: The stride must be a positive multiple of " << TRACE_GEN_WORD << " bytes." << std::endl;
+        return false;
+    }
+    if (options.writeFraction < 0 || options.writeFraction > 1 || options.zipfExponent <= 0 || options.cores < 1)
+    {
+        std::cerr << "Error: The write fraction must be in [0, 1], the Zipf exponent and core count positive." << std::endl;
+        return false;
+    }
+    generator = TraceGenerator();
+    generator.options = options;
+    generator.randomState = options.seed;
+    generator.lines = footprint / TRACE_GEN_LINE;
+    if (options.pattern == PATTERN_CHASE || options.pattern == PATTERN_MIXED)
+    {
+        // Sattolo's shuffle gives a single cycle through every line
+        std::vector<uint32_t> order(generator.lines);
+        for (uint32_t i = 0; i < generator.lines; i++)
+            order[i] = i;
+        for (uint32_t i = generator.lines - 1; i > 0; i--)
+            std::swap(order[i], order[randomBelow(generator.randomState, i)]);
+        generator.chaseNext.resize(generator.lines);
+        for (uint32_t i = 0; i < generator.lines; i++)
+            generator.chaseNext[order[i]] = order[(i + 1) % generator.lines];
+    }
+    return true;
+}
+
+// Line rank from 0 (the most popular) by inverting the continuous approximation of the
+// Zipfian distribution, which needs no table however large the footprint.
+inline uint32_t zipfRank(TraceGenerator &generator)
+{
+    double n = generator.lines;
+    double s = generator.options.zipfExponent;
+    double u = randomUnit(generator.randomState);
+    double rank;
+    if (std::fabs(1 - s) < 1e-9)
+        rank = std::exp(u * std::log(n + 1));
+    else
+        rank = std::pow(u * (std::pow(n + 1, 1 - s) - 1) + 1, 1 / (1 - s));
+    return std::min(static_cast<uint32_t>(rank) - 1, generator.lines - 1);
+}
+
+// Byte offset into the footprint of the next access of pattern.
+inline uint32_t nextPatternOffset(TraceGenerator &generator, TracePattern pattern)
+{
+    uint32_t mask = generator.options.footprint - 1;
+    switch (pattern)
+    {
+    case PATTERN_SEQUENTIAL:
+    {
+        uint32_t offset = generator.sequentialOffset;
+        generator.sequentialOffset = (offset + TRACE_GEN_WORD) & mask;
+        return offset;
+    }
+    case PATTERN_STRIDED:
+    {
+        uint32_t offset = generator.stridedOffset;
+        generator.stridedOffset = (offset + generator.options.stride) & mask;
+        return offset;
+    }
+    case PATTERN_RANDOM:
+        return randomBelow(generator.randomState, generator.options.footprint / TRACE_GEN_WORD) * TRACE_GEN_WORD;
+    case PATTERN_ZIPF:
+    {
+        // An odd multiplier permutes the lines, so the popular ones are spread out
+        uint32_t line = (zipfRank(generator) * 0x9e3779b1u) & (generator.lines - 1);
+        return line * TRACE_GEN_LINE + randomBelow(generator.randomState, TRACE_GEN_LINE / TRACE_GEN_WORD) * TRACE_GEN_WORD;
+    }
+    case PATTERN_CHASE:
+        generator.chaseLine = generator.chaseNext[generator.chaseLine];
+        return generator.chaseLine * TRACE_GEN_LINE;
+    default:
+        return 0;
+    }
+}
+
+inline TraceRecord nextGeneratedRecord(TraceGenerator &generator)
+{
+    TracePattern pattern = generator.options.pattern;
+    if (pattern == PATTERN_MIXED)
+    {
+        if (generator.generated % TRACE_GEN_PHASE == 0)
+            generator.phasePattern = static_cast<TracePattern>(randomBelow(generator.randomState, PATTERN_MIXED));
+        pattern = generator.phasePattern;
+    }
+    TraceRecord record;
+    record.address = generator.options.base + nextPatternOffset(generator, pattern);
+    record.accessType = randomUnit(generator.randomState) < generator.options.writeFraction ? 'W' : 'R';
+    record.core = static_cast<int>(generator.generated % generator.options.cores);
+    generator.generated++;
+    return record;
+}
+
+#endif